@@ -0,0 +1,142 @@
+///throughput benchmarks for cl::algo, including radix sort. Standalone executable, link against opencl.cpp, opencl_algo.cpp, pixel_convert.cpp, clock.cpp and fs_helpers.cpp
+#include <toolkit/opencl.hpp>
+#include <toolkit/opencl_algo.hpp>
+#include <toolkit/clock.hpp>
+#include <iostream>
+#include <vector>
+#include <functional>
+
+namespace
+{
+    constexpr int repeats = 20;
+
+    ///returns the mean time per iteration in seconds, after a warmup run which also waits for the kernels to build
+    double time_it(cl::command_queue& cqueue, const std::function<cl::event()>& func)
+    {
+        func().block();
+
+        steady_timer clk;
+
+        cl::event last;
+
+        for(int i=0; i < repeats; i++)
+        {
+            last = func();
+        }
+
+        last.block();
+        cqueue.block();
+
+        return clk.get_elapsed_time_s() / repeats;
+    }
+
+    template<typename T>
+    void bench_type(cl::context& ctx, cl::command_queue& cqueue, const std::string& type_name)
+    {
+        cl::algo::scratch s(ctx);
+
+        for(int64_t count = 1 << 12; count <= (1 << 26); count *= 4)
+        {
+            int64_t bytes = count * sizeof(T);
+
+            cl::buffer in(ctx);
+            in.alloc(bytes);
+            in.set_to_zero(cqueue);
+
+            cl::buffer out(ctx);
+            out.alloc(bytes);
+
+            cl::buffer flags(ctx);
+            flags.alloc(count * sizeof(cl_uint));
+
+            std::vector<cl_uint> flag_data(count);
+
+            for(int64_t i=0; i < count; i++)
+                flag_data[i] = (i % 3) == 0;
+
+            flags.write(cqueue, flag_data);
+
+            cl::buffer out_count(ctx);
+            out_count.alloc(sizeof(cl_uint));
+
+            double reduce_s = time_it(cqueue, [&]{return cl::algo::reduce<T>(cqueue, in, count, cl::algo::reduce_op::ADD, out, s);});
+            double scan_s = time_it(cqueue, [&]{return cl::algo::inclusive_scan<T>(cqueue, in, out, count, s);});
+            double compact_s = time_it(cqueue, [&]{return cl::algo::stream_compact<T>(cqueue, in, flags, count, out, out_count, s);});
+
+            auto report = [&](const std::string& name, double seconds)
+            {
+                double gelems = count / seconds / 1e9;
+                double gbs = bytes / seconds / 1e9;
+
+                std::cout << name << "," << type_name << "," << count << "," << seconds * 1000 << "," << gelems << "," << gbs << std::endl;
+            };
+
+            report("reduce", reduce_s);
+            report("inclusive_scan", scan_s);
+            report("stream_compact", compact_s);
+        }
+    }
+
+    template<typename K>
+    void bench_sort(cl::context& ctx, cl::command_queue& cqueue, const std::string& type_name)
+    {
+        cl::algo::scratch s(ctx);
+
+        for(int64_t count : {1 << 16, 1 << 20, 10 * 1000 * 1000})
+        {
+            std::vector<K> keys(count);
+
+            uint64_t state = 0x2545F4914F6CDD1Dull;
+
+            for(auto& k : keys)
+            {
+                state ^= state << 13;
+                state ^= state >> 7;
+                state ^= state << 17;
+
+                k = (K)state;
+            }
+
+            cl::buffer buf(ctx);
+            buf.alloc(count * sizeof(K));
+
+            cl::buffer values(ctx);
+            values.alloc(count * sizeof(cl_uint));
+
+            for(int bits : {4, 8})
+            {
+                ///every timed run sorts already sorted data after the first, which radix sort doesn't care about
+                buf.write(cqueue, keys);
+
+                double keys_s = time_it(cqueue, [&]{return cl::algo::radix_sort<K>(cqueue, buf, count, s, bits);});
+                double pairs_s = time_it(cqueue, [&]{return cl::algo::radix_sort_by_key<K, cl_uint>(cqueue, buf, values, count, s, bits);});
+
+                std::cout << "radix_sort_" << bits << "," << type_name << "," << count << "," << keys_s * 1000 << "," << count / keys_s / 1e9 << "," << count * sizeof(K) / keys_s / 1e9 << std::endl;
+                std::cout << "radix_sort_by_key_" << bits << "," << type_name << "," << count << "," << pairs_s * 1000 << "," << count / pairs_s / 1e9 << "," << count * (sizeof(K) + sizeof(cl_uint)) / pairs_s / 1e9 << std::endl;
+            }
+        }
+    }
+}
+
+int main()
+{
+    cl::context ctx;
+    cl::command_queue cqueue(ctx);
+
+    cl::algo::init<uint32_t>(ctx);
+    cl::algo::init<float>(ctx);
+    cl::algo::init<int64_t>(ctx);
+    cl::algo::init_radix_sort<uint32_t>(ctx);
+    cl::algo::init_radix_sort<uint64_t>(ctx);
+
+    std::cout << "primitive,type,elements,ms,gelements_per_s,gb_per_s" << std::endl;
+
+    bench_type<uint32_t>(ctx, cqueue, "uint");
+    bench_type<float>(ctx, cqueue, "float");
+    bench_type<int64_t>(ctx, cqueue, "long");
+
+    bench_sort<uint32_t>(ctx, cqueue, "uint");
+    bench_sort<uint64_t>(ctx, cqueue, "ulong");
+
+    return 0;
+}
@@ -0,0 +1,281 @@
+///host side kernel launch overhead. Standalone executable, link against opencl.cpp, pixel_convert.cpp, clock.cpp and fs_helpers.cpp
+///runs headless, eg on pocl. Every kernel is empty, so the numbers are the cost of the dispatch path rather than the device
+#include <toolkit/opencl.hpp>
+#include <toolkit/clock.hpp>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <string>
+
+namespace
+{
+    constexpr int iterations = 20000;
+    constexpr int latency_iterations = 2000;
+    ///keeps the queue from growing without bound, outside of the timed region
+    constexpr int drain_every = 1024;
+
+    const std::vector<int> arg_counts = {0, 1, 4, 8, 16};
+
+    std::string kernel_name(int arg_count, int dims)
+    {
+        return "launch_empty_" + std::to_string(arg_count) + "_" + std::to_string(dims) + "d";
+    }
+
+    ///the first argument is a buffer, the rest are ints
+    std::string make_source()
+    {
+        std::string src;
+
+        for(int dims = 1; dims <= 3; dims++)
+        {
+            for(int arg_count : arg_counts)
+            {
+                std::string params;
+
+                for(int i=0; i < arg_count; i++)
+                {
+                    if(i != 0)
+                        params += ", ";
+
+                    if(i == 0)
+                        params += "__global int* out";
+                    else
+                        params += "int a" + std::to_string(i);
+                }
+
+                std::string body;
+
+                if(arg_count > 0)
+                    body = "if(get_global_id(0) == 0xffffffff && get_global_id(" + std::to_string(dims - 1) + ") == 0xffffffff) out[0] = 1;";
+
+                src += "__kernel void " + kernel_name(arg_count, dims) + "(" + params + ") {" + body + "}\n";
+            }
+        }
+
+        return src;
+    }
+
+    cl::args make_args(cl::buffer& out, int arg_count)
+    {
+        cl::args args;
+
+        for(int i=0; i < arg_count; i++)
+        {
+            if(i == 0)
+                args.push_back(out);
+            else
+                args.push_back(i);
+        }
+
+        return args;
+    }
+
+    struct stats
+    {
+        double mean_us = 0;
+        double p50_us = 0;
+        double p99_us = 0;
+        double max_us = 0;
+    };
+
+    stats summarise(std::vector<double>& samples_s)
+    {
+        stats ret;
+
+        if(samples_s.size() == 0)
+            return ret;
+
+        std::sort(samples_s.begin(), samples_s.end());
+
+        double sum = 0;
+
+        for(double s : samples_s)
+            sum += s;
+
+        auto at = [&](double q)
+        {
+            size_t idx = std::min(samples_s.size() - 1, (size_t)(q * samples_s.size()));
+
+            return samples_s[idx] * 1000 * 1000;
+        };
+
+        ret.mean_us = sum / samples_s.size() * 1000 * 1000;
+        ret.p50_us = at(0.5);
+        ret.p99_us = at(0.99);
+        ret.max_us = samples_s.back() * 1000 * 1000;
+
+        return ret;
+    }
+
+    void report(const std::string& name, const std::string& dispatch, int arg_count, int dims, bool chained, std::vector<double>& samples_s)
+    {
+        stats s = summarise(samples_s);
+
+        std::cout << name << "," << dispatch << "," << arg_count << "," << dims << "," << (chained ? "chained" : "none") << ","
+                  << s.mean_us << "," << s.p50_us << "," << s.p99_us << "," << s.max_us << std::endl;
+    }
+
+    std::vector<size_t> global_range(int dims)
+    {
+        if(dims == 1)
+            return {64};
+
+        if(dims == 2)
+            return {8, 8};
+
+        return {4, 4, 4};
+    }
+
+    ///times each call to func individually. func is handed the previous event, and returns the next
+    std::vector<double> time_enqueues(cl::command_queue& cqueue, int count, const std::function<cl::event(const cl::event&)>& func)
+    {
+        std::vector<double> samples;
+        samples.reserve(count);
+
+        cl::event last;
+
+        for(int i=0; i < count; i++)
+        {
+            if((i % drain_every) == 0)
+            {
+                cqueue.block();
+                last = cl::event();
+            }
+
+            steady_timer clk;
+
+            last = func(last);
+
+            samples.push_back(clk.get_elapsed_time_s());
+        }
+
+        cqueue.block();
+
+        return samples;
+    }
+
+    void bench_enqueue(cl::context& ctx, cl::command_queue& cqueue, cl::buffer& out)
+    {
+        for(int dims = 1; dims <= 3; dims++)
+        {
+            for(int arg_count : arg_counts)
+            {
+                std::string name = kernel_name(arg_count, dims);
+                std::vector<size_t> global = global_range(dims);
+                std::vector<size_t> local = global;
+
+                cl::args prebuilt = make_args(out, arg_count);
+
+                ///waits for the build, and promotes the pending kernel so that fetch_kernel can find it
+                cqueue.exec(name, prebuilt, global, local);
+                cqueue.block();
+
+                cl::kernel kern = ctx.fetch_kernel(name);
+
+                for(bool chained : {false, true})
+                {
+                    auto deps = [&](const cl::event& last)
+                    {
+                        if(chained && last.native_event.data != nullptr)
+                            return std::vector<cl::event>{last};
+
+                        return std::vector<cl::event>();
+                    };
+
+                    std::vector<double> by_name = time_enqueues(cqueue, iterations, [&](const cl::event& last)
+                    {
+                        return cqueue.exec(name, prebuilt, global, local, deps(last));
+                    });
+
+                    ///the common per frame pattern, which includes building the argument pack
+                    std::vector<double> by_name_args = time_enqueues(cqueue, iterations, [&](const cl::event& last)
+                    {
+                        cl::args args = make_args(out, arg_count);
+
+                        return cqueue.exec(name, args, global, local, deps(last));
+                    });
+
+                    std::vector<double> by_kernel = time_enqueues(cqueue, iterations, [&](const cl::event& last)
+                    {
+                        kern.set_args(prebuilt);
+
+                        return cqueue.exec(kern, global, local, deps(last));
+                    });
+
+                    report("enqueue", "by_name", arg_count, dims, chained, by_name);
+                    report("enqueue", "by_name_with_args", arg_count, dims, chained, by_name_args);
+                    report("enqueue", "by_kernel", arg_count, dims, chained, by_kernel);
+                }
+            }
+        }
+    }
+
+    ///exec then block, so includes the driver's submission and completion notification
+    void bench_latency(cl::command_queue& cqueue, cl::buffer& out)
+    {
+        for(int arg_count : {0, 4})
+        {
+            std::string name = kernel_name(arg_count, 1);
+            cl::args args = make_args(out, arg_count);
+
+            std::vector<double> samples;
+            samples.reserve(latency_iterations);
+
+            for(int i=0; i < latency_iterations; i++)
+            {
+                steady_timer clk;
+
+                cqueue.exec(name, args, {64}, {64});
+                cqueue.block();
+
+                samples.push_back(clk.get_elapsed_time_s());
+            }
+
+            report("roundtrip_block", "by_name", arg_count, 1, false, samples);
+
+            std::vector<double> event_samples;
+            event_samples.reserve(latency_iterations);
+
+            for(int i=0; i < latency_iterations; i++)
+            {
+                steady_timer clk;
+
+                cl::event evt = cqueue.exec(name, args, {64}, {64});
+                evt.block();
+
+                event_samples.push_back(clk.get_elapsed_time_s());
+            }
+
+            report("roundtrip_event", "by_name", arg_count, 1, false, event_samples);
+        }
+    }
+}
+
+int main()
+{
+    cl::context ctx;
+    cl::command_queue cqueue(ctx);
+
+    std::vector<std::string> produces;
+
+    for(int dims = 1; dims <= 3; dims++)
+    {
+        for(int arg_count : arg_counts)
+            produces.push_back(kernel_name(arg_count, dims));
+    }
+
+    cl::async_build_and_cache(ctx, []{return make_source();}, produces);
+
+    cl::buffer out(ctx);
+    out.alloc(sizeof(cl_int));
+
+    std::cerr << "platform " << ctx.platform_name << std::endl;
+
+    std::cout << "case,dispatch,args,dims,deps,mean_us,p50_us,p99_us,max_us" << std::endl;
+
+    bench_enqueue(ctx, cqueue, out);
+    bench_latency(cqueue, out);
+
+    return 0;
+}
@@ -0,0 +1,264 @@
+///host/device transfer bandwidth and latency, from 4KB to 1GB. Standalone executable, link against opencl.cpp, pixel_convert.cpp, clock.cpp and fs_helpers.cpp
+///writes csv by default, or json with --json. Sizes which the device can't allocate are skipped
+#include <toolkit/opencl.hpp>
+#include <toolkit/clock.hpp>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <string.h>
+
+namespace
+{
+    constexpr int64_t min_bytes = 4 * 1024;
+    constexpr int64_t max_bytes = 1024ll * 1024 * 1024;
+    ///per size, enough repeats to move roughly this much, within [min_repeats, max_repeats]
+    constexpr int64_t target_bytes_per_case = 512ll * 1024 * 1024;
+    constexpr int min_repeats = 5;
+    constexpr int max_repeats = 200;
+
+    bool as_json = false;
+    bool first_json_row = true;
+
+    struct result
+    {
+        std::string op;
+        std::string host_memory;
+        int64_t bytes = 0;
+        int repeats = 0;
+        double mean_ms = 0;
+        double p50_ms = 0;
+        double p99_ms = 0;
+        double gb_per_s = 0;
+    };
+
+    void emit(const result& r)
+    {
+        if(as_json)
+        {
+            std::cout << (first_json_row ? "" : ",\n") << "{\"op\":\"" << r.op << "\",\"host_memory\":\"" << r.host_memory << "\",\"bytes\":" << r.bytes << ",\"repeats\":" << r.repeats
+                      << ",\"mean_ms\":" << r.mean_ms << ",\"p50_ms\":" << r.p50_ms << ",\"p99_ms\":" << r.p99_ms << ",\"gb_per_s\":" << r.gb_per_s << "}";
+
+            first_json_row = false;
+        }
+        else
+        {
+            std::cout << r.op << "," << r.host_memory << "," << r.bytes << "," << r.repeats << "," << r.mean_ms << "," << r.p50_ms << "," << r.p99_ms << "," << r.gb_per_s << std::endl;
+        }
+    }
+
+    ///func must be complete when it returns. Bandwidth is from the median, which is less sensitive to the odd stall than the mean
+    void measure(const std::string& op, const std::string& host_memory, int64_t bytes, const std::function<void()>& func)
+    {
+        int repeats = std::clamp<int64_t>(target_bytes_per_case / bytes, min_repeats, max_repeats);
+
+        func();
+
+        std::vector<double> samples;
+        samples.reserve(repeats);
+
+        for(int i=0; i < repeats; i++)
+        {
+            steady_timer clk;
+
+            func();
+
+            samples.push_back(clk.get_elapsed_time_s());
+        }
+
+        std::sort(samples.begin(), samples.end());
+
+        double sum = 0;
+
+        for(double s : samples)
+            sum += s;
+
+        auto at = [&](double q)
+        {
+            return samples[std::min(samples.size() - 1, (size_t)(q * samples.size()))];
+        };
+
+        result r;
+        r.op = op;
+        r.host_memory = host_memory;
+        r.bytes = bytes;
+        r.repeats = repeats;
+        r.mean_ms = sum / repeats * 1000;
+        r.p50_ms = at(0.5) * 1000;
+        r.p99_ms = at(0.99) * 1000;
+        r.gb_per_s = bytes / at(0.5) / 1e9;
+
+        emit(r);
+    }
+
+    ///a CL_MEM_ALLOC_HOST_PTR buffer kept mapped, which is page locked on most implementations
+    struct pinned_host
+    {
+        cl_mem mem = nullptr;
+        cl_command_queue queue = nullptr;
+        char* ptr = nullptr;
+
+        pinned_host(cl::context& ctx, cl::command_queue& cqueue, int64_t bytes)
+        {
+            cl_int err = 0;
+
+            mem = clCreateBuffer(ctx.native_context.data, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, bytes, nullptr, &err);
+
+            if(err != CL_SUCCESS)
+                throw std::runtime_error("Could not allocate pinned buffer " + std::to_string(err));
+
+            queue = cqueue.native_command_queue.data;
+
+            ptr = (char*)clEnqueueMapBuffer(queue, mem, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, bytes, 0, nullptr, nullptr, &err);
+
+            if(err != CL_SUCCESS)
+            {
+                clReleaseMemObject(mem);
+                throw std::runtime_error("Could not map pinned buffer " + std::to_string(err));
+            }
+        }
+
+        ~pinned_host()
+        {
+            clEnqueueUnmapMemObject(queue, mem, ptr, 0, nullptr, nullptr);
+            clFinish(queue);
+            clReleaseMemObject(mem);
+        }
+    };
+
+    void bench_buffers(cl::context& ctx, cl::command_queue& cqueue, int64_t bytes)
+    {
+        cl::buffer dev(ctx);
+        dev.alloc(bytes);
+
+        cl::buffer dev2(ctx);
+        dev2.alloc(bytes);
+
+        std::vector<char> pageable(bytes, 1);
+
+        measure("write", "pageable", bytes, [&]{dev.write(cqueue, pageable.data(), bytes);});
+        measure("read", "pageable", bytes, [&]{dev.read(cqueue, pageable.data(), bytes);});
+        ///includes the copy write_async makes of the source
+        measure("write_async", "pageable", bytes, [&]{dev.write_async(cqueue, pageable.data(), bytes).block();});
+        measure("read_async", "pageable", bytes, [&]{dev.read_async(cqueue, pageable.data(), bytes, {}).block();});
+
+        {
+            pinned_host pinned(ctx, cqueue, bytes);
+
+            memset(pinned.ptr, 1, bytes);
+
+            measure("write", "pinned", bytes, [&]{dev.write(cqueue, pinned.ptr, bytes);});
+            measure("read", "pinned", bytes, [&]{dev.read(cqueue, pinned.ptr, bytes);});
+            measure("write_async", "pinned", bytes, [&]{dev.write_async(cqueue, pinned.ptr, bytes).block();});
+            measure("read_async", "pinned", bytes, [&]{dev.read_async(cqueue, pinned.ptr, bytes, {}).block();});
+        }
+
+        cl_command_queue queue = cqueue.native_command_queue.data;
+
+        ///host access through a mapping of the device buffer, rather than a copy into it
+        measure("map_write", "pageable", bytes, [&]
+        {
+            cl_int err = 0;
+            void* ptr = clEnqueueMapBuffer(queue, dev.native_mem_object.data, CL_TRUE, CL_MAP_WRITE_INVALIDATE_REGION, 0, bytes, 0, nullptr, nullptr, &err);
+
+            if(err != CL_SUCCESS)
+                throw std::runtime_error("Could not map for writing " + std::to_string(err));
+
+            memcpy(ptr, pageable.data(), bytes);
+
+            clEnqueueUnmapMemObject(queue, dev.native_mem_object.data, ptr, 0, nullptr, nullptr);
+            clFinish(queue);
+        });
+
+        measure("map_read", "pageable", bytes, [&]
+        {
+            cl_int err = 0;
+            void* ptr = clEnqueueMapBuffer(queue, dev.native_mem_object.data, CL_TRUE, CL_MAP_READ, 0, bytes, 0, nullptr, nullptr, &err);
+
+            if(err != CL_SUCCESS)
+                throw std::runtime_error("Could not map for reading " + std::to_string(err));
+
+            memcpy(pageable.data(), ptr, bytes);
+
+            clEnqueueUnmapMemObject(queue, dev.native_mem_object.data, ptr, 0, nullptr, nullptr);
+            clFinish(queue);
+        });
+
+        measure("copy", "device", bytes, [&]{cl::copy(cqueue, dev, dev2).block();});
+        measure("fill", "device", bytes, [&]{dev.fill(cqueue, 0x01020304).block();});
+        measure("set_to_zero", "device", bytes, [&]{dev.set_to_zero(cqueue).block();});
+    }
+
+    void bench_images(cl::context& ctx, cl::command_queue& cqueue, int64_t bytes)
+    {
+        int64_t pixels = bytes / (sizeof(cl_float) * 4);
+
+        const cl::device_caps& caps = ctx.get_caps();
+
+        if(!caps.image_support)
+            return;
+
+        int64_t max_width = caps.image2d_max_width;
+        int64_t max_height = caps.image2d_max_height;
+
+        int64_t width = std::min<int64_t>(pixels, 8192);
+        int64_t height = pixels / width;
+
+        if(width > max_width || height > max_height || width * height * 16 != bytes)
+            return;
+
+        cl::image img(ctx);
+        img.alloc((vec2i){(int)width, (int)height}, {CL_RGBA, CL_FLOAT});
+
+        std::vector<char> pageable(bytes, 0);
+
+        measure("image_write", "pageable", bytes, [&]{img.write(cqueue, pageable.data(), vec<2, size_t>{0, 0}, vec<2, size_t>{(size_t)width, (size_t)height}); cqueue.block();});
+        measure("image_read", "pageable", bytes, [&]{img.read_impl(cqueue, {0, 0, 0, 0}, {(size_t)width, (size_t)height, 1, 1}, pageable.data());});
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    for(int i=1; i < argc; i++)
+    {
+        if(std::string(argv[i]) == "--json")
+            as_json = true;
+    }
+
+    cl::context ctx;
+    cl::command_queue cqueue(ctx);
+
+    int64_t max_alloc = ctx.get_caps().max_mem_alloc_size;
+
+    std::cerr << "platform " << ctx.platform_name << ", device " << ctx.get_caps().name << ", max allocation " << max_alloc << std::endl;
+
+    if(as_json)
+        std::cout << "[\n";
+    else
+        std::cout << "op,host_memory,bytes,repeats,mean_ms,p50_ms,p99_ms,gb_per_s" << std::endl;
+
+    for(int64_t bytes = min_bytes; bytes <= max_bytes; bytes *= 4)
+    {
+        if(bytes > max_alloc)
+        {
+            std::cerr << "skipping " << bytes << " bytes, above the device's max allocation" << std::endl;
+            continue;
+        }
+
+        try
+        {
+            bench_buffers(ctx, cqueue, bytes);
+            bench_images(ctx, cqueue, bytes);
+        }
+        catch(std::exception& e)
+        {
+            std::cerr << "skipping the rest of " << bytes << " bytes: " << e.what() << std::endl;
+        }
+    }
+
+    if(as_json)
+        std::cout << "\n]" << std::endl;
+
+    return 0;
+}
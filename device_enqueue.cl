@@ -0,0 +1,49 @@
+#ifndef DEVICE_ENQUEUE_CL_INCLUDED
+#define DEVICE_ENQUEUE_CL_INCLUDED
+
+///device side enqueue, for work which is only discovered on the device, eg adaptive refinement. #include into a program built with
+///-cl-std=CL2.0, with a cl::device_command_queue created on the host. Children see their own ndrange, so the parent passes down anything they need to index with
+#if defined(__OPENCL_C_VERSION__) && __OPENCL_C_VERSION__ >= 200
+
+///child ranges are rounded up to a whole number of work groups, so children must bounds check against count
+size_t enqueue_round_up(size_t count, size_t local_size)
+{
+    return ((max(count, (size_t)1) + local_size - 1) / local_size) * local_size;
+}
+
+ndrange_t enqueue_range_1d(size_t count, size_t local_size)
+{
+    return ndrange_1D(enqueue_round_up(count, local_size), local_size);
+}
+
+ndrange_t enqueue_range_2d(size_t count_x, size_t count_y, size_t local_x, size_t local_y)
+{
+    const size_t global[2] = {enqueue_round_up(count_x, local_x), enqueue_round_up(count_y, local_y)};
+    const size_t local[2] = {local_x, local_y};
+
+    return ndrange_2D(global, local);
+}
+
+///reserves count consecutive slots in a worklist, returning the first. Lets every work item of a level append the items it refines into
+///one list, so that the next level is a single launch over counter's final value rather than a launch per parent item
+uint worklist_reserve(volatile __global atomic_uint* counter, uint count)
+{
+    return atomic_fetch_add_explicit(counter, count, memory_order_relaxed, memory_scope_device);
+}
+
+///enqueues the block, the last argument, over count work items. It starts once the enqueuing kernel has finished, so sees everything it wrote
+///evaluates to the enqueue_kernel status. A failure is usually CLK_DEVICE_QUEUE_FULL, meaning the device_command_queue is too small
+#define ENQUEUE_AFTER_PARENT_1D(queue, count, local_size, ...) \
+    enqueue_kernel(queue, CLK_ENQUEUE_FLAGS_WAIT_KERNEL, enqueue_range_1d(count, local_size), __VA_ARGS__)
+
+#define ENQUEUE_AFTER_PARENT_2D(queue, count_x, count_y, local_x, local_y, ...) \
+    enqueue_kernel(queue, CLK_ENQUEUE_FLAGS_WAIT_KERNEL, enqueue_range_2d(count_x, count_y, local_x, local_y), __VA_ARGS__)
+
+///enqueues the block as a single work item, once the enqueuing kernel has finished. Worklist counters are final by then, so it can read
+///one and size the next level's ENQUEUE_AFTER_PARENT_1D from it, without a host round trip. Only one work item per level should call this
+#define ENQUEUE_LAUNCHER(queue, ...) \
+    enqueue_kernel(queue, CLK_ENQUEUE_FLAGS_WAIT_KERNEL, ndrange_1D(1), __VA_ARGS__)
+
+#endif
+
+#endif // DEVICE_ENQUEUE_CL_INCLUDED
@@ -1,16 +1,118 @@
-float4 faux_clamp(__read_only image2d_t buf, int2 test, int2 minb, int2 maxb, float4 fallback)
+#include "stencil.cl"
+
+///taps outside the region fall back to the centre pixel
+float4 stencil_cross_blur(struct stencil_tile st, float param)
 {
-    float mixer = any(test < minb) || any(test >= maxb);
+    float4 centre = stencil_tap(st, 0, 0);
+
+    float4 up = stencil_inside(st, 0, -1) ? stencil_tap(st, 0, -1) : centre;
+    float4 left = stencil_inside(st, -1, 0) ? stencil_tap(st, -1, 0) : centre;
+    float4 right = stencil_inside(st, 1, 0) ? stencil_tap(st, 1, 0) : centre;
+    float4 down = stencil_inside(st, 0, 1) ? stencil_tap(st, 0, 1) : centre;
 
-    sampler_t sam = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+    float4 out = (left + right + up + down + centre) / 5.f;
 
-    return mix(read_imagef(buf, sam, test), fallback, mixer);
+    return clamp(out, 0.f, 1.f);
 }
 
 __kernel
+__attribute__((reqd_work_group_size(STENCIL_TILE_W, STENCIL_TILE_H, 1)))
 void blur_image(__read_only image2d_t read_buf, __write_only image2d_t write_buf, int w, int h, int ox, int oy)
+STENCIL_BODY(1, 1, 1, stencil_cross_blur, 0.f)
+
+///separable gaussian, param is sigma in pixels. The reach is fixed at compile time
+#ifndef GAUSSIAN_RADIUS
+#define GAUSSIAN_RADIUS 8
+#endif
+
+float4 stencil_gaussian(struct stencil_tile st, float sigma, int2 dir)
+{
+    float4 sum = 0;
+    float weight_sum = 0;
+
+    float inv = 1.f / (2 * sigma * sigma);
+
+    for(int i=-GAUSSIAN_RADIUS; i <= GAUSSIAN_RADIUS; i++)
+    {
+        float weight = exp(-(i * i) * inv);
+
+        sum += stencil_tap(st, i * dir.x, i * dir.y) * weight;
+        weight_sum += weight;
+    }
+
+    return sum / weight_sum;
+}
+
+float4 stencil_gaussian_h(struct stencil_tile st, float sigma)
+{
+    return stencil_gaussian(st, sigma, (int2)(1, 0));
+}
+
+float4 stencil_gaussian_v(struct stencil_tile st, float sigma)
 {
-    sampler_t sam = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+    return stencil_gaussian(st, sigma, (int2)(0, 1));
+}
+
+STENCIL_KERNEL(gaussian_blur_h, 1, GAUSSIAN_RADIUS, 0, stencil_gaussian_h)
+STENCIL_KERNEL(gaussian_blur_v, 1, 0, GAUSSIAN_RADIUS, stencil_gaussian_v)
+
+///sobel magnitude of luminance, scaled by param. Alpha is preserved
+float4 stencil_sobel(struct stencil_tile st, float scale)
+{
+    float3 lum_weights = (float3)(0.2126f, 0.7152f, 0.0722f);
+
+    float l[3][3];
+
+    for(int y=-1; y <= 1; y++)
+    {
+        for(int x=-1; x <= 1; x++)
+        {
+            l[y + 1][x + 1] = dot(stencil_tap(st, x, y).xyz, lum_weights);
+        }
+    }
+
+    float gx = (l[0][2] + 2 * l[1][2] + l[2][2]) - (l[0][0] + 2 * l[1][0] + l[2][0]);
+    float gy = (l[2][0] + 2 * l[2][1] + l[2][2]) - (l[0][0] + 2 * l[0][1] + l[0][2]);
+
+    float mag = clamp(sqrt(gx * gx + gy * gy) * scale, 0.f, 1.f);
+
+    return (float4)(mag, mag, mag, stencil_tap(st, 0, 0).w);
+}
+
+STENCIL_KERNEL(sobel_edges, 1, 1, 1, stencil_sobel)
+
+///2x downsample with a [1 3 3 1] tent along each axis. The output region is in destination pixels
+float4 stencil_tent_downsample(struct stencil_tile st, float param)
+{
+    float weights[4] = {1, 3, 3, 1};
+
+    float4 sum = 0;
+
+    for(int y=0; y < 4; y++)
+    {
+        for(int x=0; x < 4; x++)
+        {
+            sum += stencil_tap(st, x - 1, y - 1) * weights[x] * weights[y];
+        }
+    }
+
+    return sum / 64.f;
+}
+
+STENCIL_KERNEL(downsample_2x, 2, 1, 1, stencil_tent_downsample)
+
+///rect is (x0, y0, x1, y1) in source pixels. Keeps bilinear taps inside the rect so nothing outside the window bleeds in
+float2 frost_clamp(float2 pos, float4 rect)
+{
+    return clamp(pos, rect.xy + 0.5f, rect.zw - 0.5f);
+}
+
+///dual kawase downsample, the destination is half the resolution of the source
+///every tap is bilinear, so 5 taps cover a 4x4 source footprint
+__kernel
+void frost_downsample(__read_only image2d_t read_buf, __write_only image2d_t write_buf, float4 src_rect, int w, int h, int ox, int oy, float offset)
+{
+    sampler_t sam = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
 
     int x = get_global_id(0);
     int y = get_global_id(1);
@@ -21,19 +123,95 @@ void blur_image(__read_only image2d_t read_buf, __write_only image2d_t write_buf
     x += ox;
     y += oy;
 
-    float4 centre = read_imagef(read_buf, sam, (int2){x, y});
+    ///the corner shared by the 2x2 source pixels under this destination pixel
+    float2 centre = (float2)(x * 2 + 1, y * 2 + 1);
 
-    float4 up = faux_clamp(read_buf, (int2){x, y-1}, (int2){ox, oy}, (int2){ox + w, oy + h}, centre);
-    float4 left = faux_clamp(read_buf, (int2){x-1, y}, (int2){ox, oy}, (int2){ox + w, oy + h}, centre);
-    float4 right = faux_clamp(read_buf, (int2){x+1, y}, (int2){ox, oy}, (int2){ox + w, oy + h}, centre);
-    float4 down = faux_clamp(read_buf, (int2){x, y+1}, (int2){ox, oy}, (int2){ox + w, oy + h}, centre);
+    float4 out = read_imagef(read_buf, sam, frost_clamp(centre, src_rect)) * 4;
 
-    float4 out = (left + right + up + down + centre) / 5.f;
+    out += read_imagef(read_buf, sam, frost_clamp(centre + (float2)(-offset, -offset), src_rect));
+    out += read_imagef(read_buf, sam, frost_clamp(centre + (float2)(offset, -offset), src_rect));
+    out += read_imagef(read_buf, sam, frost_clamp(centre + (float2)(-offset, offset), src_rect));
+    out += read_imagef(read_buf, sam, frost_clamp(centre + (float2)(offset, offset), src_rect));
+
+    if(x < 0 || y < 0 || x >= get_image_width(write_buf) || y >= get_image_height(write_buf))
+        return;
+
+    write_imagef(write_buf, (int2){x, y}, out / 8.f);
+}
+
+float4 frost_upsample_at(__read_only image2d_t read_buf, float2 centre, float4 src_rect, float offset)
+{
+    sampler_t sam = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+
+    float half_offset = offset / 2.f;
+
+    float4 out = 0;
+
+    out += read_imagef(read_buf, sam, frost_clamp(centre + (float2)(-offset, 0), src_rect));
+    out += read_imagef(read_buf, sam, frost_clamp(centre + (float2)(offset, 0), src_rect));
+    out += read_imagef(read_buf, sam, frost_clamp(centre + (float2)(0, -offset), src_rect));
+    out += read_imagef(read_buf, sam, frost_clamp(centre + (float2)(0, offset), src_rect));
+
+    out += read_imagef(read_buf, sam, frost_clamp(centre + (float2)(-half_offset, -half_offset), src_rect)) * 2;
+    out += read_imagef(read_buf, sam, frost_clamp(centre + (float2)(half_offset, -half_offset), src_rect)) * 2;
+    out += read_imagef(read_buf, sam, frost_clamp(centre + (float2)(-half_offset, half_offset), src_rect)) * 2;
+    out += read_imagef(read_buf, sam, frost_clamp(centre + (float2)(half_offset, half_offset), src_rect)) * 2;
+
+    return out / 12.f;
+}
+
+///dual kawase upsample, the destination is twice the resolution of the source
+__kernel
+void frost_upsample(__read_only image2d_t read_buf, __write_only image2d_t write_buf, float4 src_rect, int w, int h, int ox, int oy, float offset)
+{
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+
+    if(x >= w || y >= h)
+        return;
+
+    x += ox;
+    y += oy;
+
+    float4 out = frost_upsample_at(read_buf, (float2)(x + 0.5f, y + 0.5f) / 2.f, src_rect, offset);
 
     if(x < 0 || y < 0 || x >= get_image_width(write_buf) || y >= get_image_height(write_buf))
         return;
 
-    out = clamp(out, 0.f, 1.f);
+    write_imagef(write_buf, (int2){x, y}, clamp(out, 0.f, 1.f));
+}
+
+///the last upsample of a batched frost. Covers the union of every frosted rect, but only writes pixels inside one of them
+///rects are (x0, y0, x1, y1) half open, in destination pixels
+__kernel
+void frost_composite(__read_only image2d_t read_buf, __write_only image2d_t write_buf, float4 src_rect, int w, int h, int ox, int oy, float offset,
+                     __global const int4* rects, int rect_count)
+{
+    int x = get_global_id(0);
+    int y = get_global_id(1);
+
+    if(x >= w || y >= h)
+        return;
+
+    x += ox;
+    y += oy;
+
+    bool covered = false;
+
+    for(int i=0; i < rect_count; i++)
+    {
+        int4 r = rects[i];
+
+        covered = covered || (x >= r.x && y >= r.y && x < r.z && y < r.w);
+    }
+
+    if(!covered)
+        return;
+
+    float4 out = frost_upsample_at(read_buf, (float2)(x + 0.5f, y + 0.5f) / 2.f, src_rect, offset);
+
+    if(x < 0 || y < 0 || x >= get_image_width(write_buf) || y >= get_image_height(write_buf))
+        return;
 
-    write_imagef(write_buf, (int2){x, y}, out);
+    write_imagef(write_buf, (int2){x, y}, clamp(out, 0.f, 1.f));
 }
@@ -15,7 +15,12 @@
 #include "clock.hpp"
 #include <mutex>
 #include <toolkit/fs_helpers.hpp>
+#include "pixel_convert.hpp"
 #include <semaphore>
+#include <limits>
+#include <filesystem>
+#include <set>
+#include <future>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -115,14 +120,344 @@ std::vector<cl_event> to_raw_events(const std::vector<cl::event>& events)
 
     return ret;
 }
+
+struct tracked_allocation
+{
+    std::shared_ptr<cl::memory_tracker> tracker;
+    std::string tag;
+    int64_t bytes = 0;
+    bool is_image = false;
+};
+
+void CL_CALLBACK release_tracked_allocation(cl_mem mem, void* user_data)
+{
+    tracked_allocation* alloc = (tracked_allocation*)user_data;
+
+    alloc->tracker->remove(alloc->tag, alloc->bytes, alloc->is_image);
+
+    delete alloc;
 }
 
-void cl::event::block()
+std::string tag_or_default(const std::string& tag)
 {
-    if(native_event.data == nullptr)
+    return tag.size() > 0 ? tag : "untagged";
+}
+
+std::string tag_or_default(const char* tag)
+{
+    return tag != nullptr && tag[0] != '\0' ? tag : "untagged";
+}
+
+///mem_objects find their context's tracker through their cl_context when they allocate, rather than each holding a reference to it
+std::mutex tracker_mut;
+std::map<cl_context, std::weak_ptr<cl::memory_tracker>> trackers;
+
+void register_tracker(cl_context ctx, const std::shared_ptr<cl::memory_tracker>& tracker)
+{
+    if(ctx == nullptr || tracker == nullptr)
+        return;
+
+    std::scoped_lock guard(tracker_mut);
+
+    trackers[ctx] = tracker;
+}
+
+std::shared_ptr<cl::memory_tracker> find_tracker(cl_context ctx)
+{
+    std::scoped_lock guard(tracker_mut);
+
+    auto it = trackers.find(ctx);
+
+    if(it == trackers.end())
+        return nullptr;
+
+    return it->second.lock();
+}
+
+void track_allocation(cl_context ctx, cl_mem mem, const char* memory_tag, bool is_image)
+{
+    if(mem == nullptr)
+        return;
+
+    std::shared_ptr<cl::memory_tracker> tracker = find_tracker(ctx);
+
+    if(tracker == nullptr)
+        return;
+
+    std::string tag = tag_or_default(memory_tag);
+
+    size_t bytes = 0;
+
+    if(clGetMemObjectInfo(mem, CL_MEM_SIZE, sizeof(bytes), &bytes, nullptr) != CL_SUCCESS)
+        return;
+
+    tracked_allocation* alloc = new tracked_allocation{tracker, tag, (int64_t)bytes, is_image};
+
+    tracker->add(tag, bytes, is_image);
+
+    if(clSetMemObjectDestructorCallback(mem, release_tracked_allocation, alloc) != CL_SUCCESS)
+    {
+        tracker->remove(tag, bytes, is_image);
+        delete alloc;
+    }
+}
+}
+
+const char* cl::intern_memory_tag(std::string_view tag)
+{
+    static std::mutex mut;
+    static std::set<std::string, std::less<>> tags;
+
+    std::scoped_lock guard(mut);
+
+    auto it = tags.find(tag);
+
+    if(it == tags.end())
+        it = tags.emplace(tag).first;
+
+    return it->c_str();
+}
+
+void cl::memory_tracker::add(const std::string& tag, int64_t bytes, bool is_image)
+{
+    bool should_warn = false;
+    int64_t live_now = 0;
+
+    {
+        std::scoped_lock guard(mut);
+
+        memory_snapshot::usage& use = tags[tag_or_default(tag)];
+        use.live_bytes += bytes;
+        use.peak_bytes = std::max(use.peak_bytes, use.live_bytes);
+        use.live_allocations++;
+
+        live_bytes += bytes;
+        peak_bytes = std::max(peak_bytes, live_bytes);
+
+        if(is_image)
+            image_bytes += bytes;
+        else
+            buffer_bytes += bytes;
+
+        if(device_global_mem_size > 0 && live_bytes >= warn_fraction * device_global_mem_size && !warned)
+        {
+            warned = true;
+            should_warn = true;
+        }
+
+        live_now = live_bytes;
+    }
+
+    if(should_warn)
+    {
+        std::cout << "Warning: live OpenCL allocations are " << live_now / (1024 * 1024) << "MB of " << device_global_mem_size / (1024 * 1024) << "MB device memory, latest tag " << tag_or_default(tag) << std::endl;
+    }
+}
+
+void cl::memory_tracker::remove(const std::string& tag, int64_t bytes, bool is_image)
+{
+    std::scoped_lock guard(mut);
+
+    memory_snapshot::usage& use = tags[tag_or_default(tag)];
+    use.live_bytes -= bytes;
+    use.live_allocations--;
+
+    live_bytes -= bytes;
+
+    if(is_image)
+        image_bytes -= bytes;
+    else
+        buffer_bytes -= bytes;
+
+    if(live_bytes < warn_fraction * device_global_mem_size)
+        warned = false;
+}
+
+cl::memory_snapshot cl::memory_tracker::snapshot()
+{
+    std::scoped_lock guard(mut);
+
+    memory_snapshot ret;
+    ret.tags = tags;
+    ret.live_bytes = live_bytes;
+    ret.peak_bytes = peak_bytes;
+    ret.buffer_bytes = buffer_bytes;
+    ret.image_bytes = image_bytes;
+    ret.device_global_mem_size = device_global_mem_size;
+
+    return ret;
+}
+
+namespace
+{
+    std::atomic<int64_t> wait_spin_us{0};
+    std::atomic<int64_t> wait_yield_us{0};
+
+    ///complete, or failed
+    bool is_terminal(cl_event evt)
+    {
+        cl_int status = CL_COMPLETE;
+
+        if(clGetEventInfo(evt, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(cl_int), (void*)&status, nullptr) != CL_SUCCESS)
+            throw std::runtime_error("Bad event in clGetEventInfo in is_terminal");
+
+        return status <= CL_COMPLETE;
+    }
+
+    ///polls done until it returns true or the policy's budgets run out. Returns false if the caller should fall back to the driver's wait
+    template<typename F>
+    bool poll_with_policy(const cl::wait_policy& policy, F&& done)
+    {
+        if(policy.spin_us == 0 && policy.yield_us == 0)
+            return false;
+
+        steady_timer spin_clk;
+
+        while(spin_clk.get_elapsed_time_s() * 1000 * 1000 < policy.spin_us)
+        {
+            if(done())
+                return true;
+        }
+
+        steady_timer yield_clk;
+
+        while(policy.yield_us < 0 || yield_clk.get_elapsed_time_s() * 1000 * 1000 < policy.yield_us)
+        {
+            if(done())
+                return true;
+
+            std::this_thread::yield();
+        }
+
+        return done();
+    }
+
+    ///shared between wait_any and the completion callbacks it registers, which may outlive the call
+    struct wait_any_state
+    {
+        std::atomic_bool fired{false};
+        std::atomic_int refs{0};
+
+        void release()
+        {
+            if(refs.fetch_sub(1) == 1)
+                delete this;
+        }
+    };
+
+    void CL_CALLBACK on_wait_any_complete(cl_event evt, cl_int event_command_status, void* user_data)
+    {
+        wait_any_state* state = (wait_any_state*)user_data;
+
+        state->fired = true;
+        state->fired.notify_all();
+
+        state->release();
+    }
+}
+
+void cl::set_wait_policy(const wait_policy& policy)
+{
+    wait_spin_us = policy.spin_us;
+    wait_yield_us = policy.yield_us;
+}
+
+cl::wait_policy cl::get_wait_policy()
+{
+    wait_policy ret;
+    ret.spin_us = wait_spin_us;
+    ret.yield_us = wait_yield_us;
+
+    return ret;
+}
+
+void cl::wait_all(std::span<const event> events, const wait_policy& policy)
+{
+    std::vector<cl_event> remaining;
+
+    for(const event& e : events)
+    {
+        if(e.native_event.data != nullptr)
+            remaining.push_back(e.native_event.data);
+    }
+
+    if(remaining.size() == 0)
         return;
 
-    clWaitForEvents(1, &native_event.data);
+    auto done = [&]()
+    {
+        while(remaining.size() > 0 && is_terminal(remaining.back()))
+            remaining.pop_back();
+
+        return remaining.size() == 0;
+    };
+
+    if(poll_with_policy(policy, done))
+        return;
+
+    clWaitForEvents(remaining.size(), remaining.data());
+}
+
+int cl::wait_any(std::span<const event> events, const wait_policy& policy)
+{
+    int found = -1;
+    bool any_live = false;
+
+    auto done = [&]()
+    {
+        for(int i=0; i < (int)events.size(); i++)
+        {
+            if(events[i].native_event.data == nullptr)
+                continue;
+
+            any_live = true;
+
+            if(is_terminal(events[i].native_event.data))
+            {
+                found = i;
+                return true;
+            }
+        }
+
+        return !any_live;
+    };
+
+    if(done() || poll_with_policy(policy, done))
+        return found;
+
+    ///clWaitForEvents can only wait for all of them
+    wait_any_state* state = new wait_any_state;
+    state->refs = 1;
+
+    for(const event& e : events)
+    {
+        if(e.native_event.data == nullptr)
+            continue;
+
+        state->refs++;
+
+        if(clSetEventCallback(e.native_event.data, CL_COMPLETE, on_wait_any_complete, state) != CL_SUCCESS)
+        {
+            state->release();
+            state->release();
+            throw std::runtime_error("Could not set callback in wait_any");
+        }
+    }
+
+    while(!done())
+    {
+        state->fired.wait(false);
+        state->fired = false;
+    }
+
+    state->release();
+
+    return found;
+}
+
+void cl::event::block()
+{
+    wait_all(std::span<const event>(this, 1));
 }
 
 bool cl::event::is_finished()
@@ -238,153 +573,323 @@ cl::kernel cl::kernel::clone()
     return ret;
 }
 
-cl::context::context()
+namespace
 {
-    shared = std::make_shared<shared_kernel_info>();
+    ///gl sharing needs the gl context which is current on the constructing thread, so it's read there even when creation is deferred
+    struct gl_sharing_handles
+    {
+        #ifdef _WIN32
+        HGLRC gl_context = nullptr;
+        HDC dc = nullptr;
+        #elif !defined(__APPLE__)
+        GLXContext gl_context = nullptr;
+        Display* display = nullptr;
+        #endif
+    };
 
-    cl_platform_id pid = get_platform_ids();
-    platform_name = get_platform_name(pid);
+    gl_sharing_handles capture_gl_sharing_handles()
+    {
+        gl_sharing_handles ret;
 
-    cl_uint num_devices = 0;
-    cl_device_id devices[100] = {};
+        #ifdef _WIN32
+        ret.gl_context = wglGetCurrentContext();
+        ret.dc = wglGetCurrentDC();
+        #elif !defined(__APPLE__)
+        ret.gl_context = glXGetCurrentContext();
+        ret.display = glXGetCurrentDisplay();
+        #endif
 
-    CHECK(clGetDeviceIDs(pid, CL_DEVICE_TYPE_GPU, 1, devices, &num_devices));
+        return ret;
+    }
 
-    selected_device = devices[0];
+    struct created_context
+    {
+        cl::base<cl_context, clRetainContext, clReleaseContext> native_context;
+        cl_device_id selected_device = nullptr;
+        std::string platform_name;
+        std::shared_ptr<const cl::device_caps> caps;
+    };
 
-    if(cl::supports_extension(selected_device, "cl_khr_gl_sharing"))
+    ///the slow part of context creation, mostly loading the icd and initialising the driver. Safe to run on any thread
+    created_context create_native_context(const gl_sharing_handles& handles)
     {
-        #ifdef _WIN32
-        cl_context_properties props[] =
-        {
-            CL_GL_CONTEXT_KHR, (cl_context_properties)wglGetCurrentContext(),
-            CL_WGL_HDC_KHR, (cl_context_properties)wglGetCurrentDC(),
-            CL_CONTEXT_PLATFORM, (cl_context_properties)pid,
-            0
-        };
-        #elif defined(__APPLE__)
-        CGLContextObj cgl_context = CGLGetCurrentContext();
-        CGLShareGroupObj cgl_share_group = CGLGetShareGroup(cgl_current_context);
-
-        cl_context_properties properties[] = {
-            CL_CONTEXT_PROPERTY_USE_CGL_SHAREGROUP_APPLE,
-            (cl_context_properties) cgl_share_group,
-            0
-        };
-        #else
-        cl_context_properties props[] =
-        {
-            CL_GL_CONTEXT_KHR, (cl_context_properties)glXGetCurrentContext(),
-            CL_GLX_DISPLAY_KHR, (cl_context_properties)glXGetCurrentDisplay(),
-            CL_CONTEXT_PLATFORM, (cl_context_properties)pid,
-            0
-        };
-        #endif
+        created_context ret;
 
-        cl_int error = 0;
+        cl_platform_id pid = get_platform_ids();
+        ret.platform_name = get_platform_name(pid);
 
-        cl_context ctx = clCreateContext(props, 1, &selected_device, nullptr, nullptr, &error);
+        cl_uint num_devices = 0;
+        cl_device_id devices[100] = {};
 
-        if(error != CL_SUCCESS)
-            throw std::runtime_error("Failed to create context " + std::to_string(error));
+        ///headless machines may only have a cpu implementation, eg pocl
+        if(clGetDeviceIDs(pid, CL_DEVICE_TYPE_GPU, 1, devices, &num_devices) != CL_SUCCESS || num_devices == 0)
+            CHECK(clGetDeviceIDs(pid, CL_DEVICE_TYPE_ALL, 1, devices, &num_devices));
 
-        native_context.data = ctx;
-    }
-    else
-    {
-        cl_context_properties props[] =
+        cl_device_id selected_device = devices[0];
+
+        ret.selected_device = selected_device;
+        ret.caps = cl::get_device_caps(selected_device);
+
+        if(ret.caps->has_extension("cl_khr_gl_sharing"))
         {
-            CL_CONTEXT_PLATFORM, (cl_context_properties)pid,
-            0
-        };
+            #ifdef _WIN32
+            cl_context_properties props[] =
+            {
+                CL_GL_CONTEXT_KHR, (cl_context_properties)handles.gl_context,
+                CL_WGL_HDC_KHR, (cl_context_properties)handles.dc,
+                CL_CONTEXT_PLATFORM, (cl_context_properties)pid,
+                0
+            };
+            #elif defined(__APPLE__)
+            CGLContextObj cgl_context = CGLGetCurrentContext();
+            CGLShareGroupObj cgl_share_group = CGLGetShareGroup(cgl_current_context);
+
+            cl_context_properties properties[] = {
+                CL_CONTEXT_PROPERTY_USE_CGL_SHAREGROUP_APPLE,
+                (cl_context_properties) cgl_share_group,
+                0
+            };
+            #else
+            cl_context_properties props[] =
+            {
+                CL_GL_CONTEXT_KHR, (cl_context_properties)handles.gl_context,
+                CL_GLX_DISPLAY_KHR, (cl_context_properties)handles.display,
+                CL_CONTEXT_PLATFORM, (cl_context_properties)pid,
+                0
+            };
+            #endif
 
-        cl_int error = 0;
+            cl_int error = 0;
 
-        cl_context ctx = clCreateContext(props, 1, &selected_device, nullptr, nullptr, &error);
+            cl_context ctx = clCreateContext(props, 1, &selected_device, nullptr, nullptr, &error);
 
-        if(error != CL_SUCCESS)
-            throw std::runtime_error("Failed to create context " + std::to_string(error));
+            if(error != CL_SUCCESS)
+                throw std::runtime_error("Failed to create context " + std::to_string(error));
 
-        native_context.data = ctx;
-    }
-}
+            ret.native_context.data = ctx;
+        }
+        else
+        {
+            cl_context_properties props[] =
+            {
+                CL_CONTEXT_PLATFORM, (cl_context_properties)pid,
+                0
+            };
 
-void cl::context::register_program(cl::program& p)
-{
-    p.ensure_built();
+            cl_int error = 0;
 
-    std::scoped_lock lock(shared->mut);
+            cl_context ctx = clCreateContext(props, 1, &selected_device, nullptr, nullptr, &error);
 
-    std::map<std::string, cl::kernel, std::less<>>& which = shared->kernels.emplace_back();
+            if(error != CL_SUCCESS)
+                throw std::runtime_error("Failed to create context " + std::to_string(error));
 
-    for(auto& [name, kern] : p.async->built_kernels)
-    {
-        which[name] = kern;
+            ret.native_context.data = ctx;
+        }
+
+        return ret;
     }
 }
 
-void cl::context::deregister_program(int idx)
+struct cl::deferred_context_creation
 {
-    std::scoped_lock lock(shared->mut);
+    std::shared_future<created_context> result;
+    ///the memory tracker is shared between every copy of the context, so is only filled in and registered by the first to resolve
+    std::once_flag publish_tracker;
+};
 
-    if(idx < 0 || idx >= (int)shared->kernels.size())
-        throw std::runtime_error("idx < 0 || idx >= kernels->size() in deregister_program for cl::context");
+cl::context::context() : context(false)
+{
 
-    shared->kernels.erase(shared->kernels.begin() + idx);
 }
 
-void cl::context::register_kernel(const cl::kernel& kern, std::optional<std::string> name_override, bool can_overlap_existing)
+cl::context::context(bool deferred)
 {
-    std::scoped_lock lock(shared->mut);
+    shared = std::make_shared<shared_kernel_info>();
+    memory = std::make_shared<memory_tracker>();
+    managed = std::make_shared<managed_pool>();
+    managed->memory = memory;
 
-    std::string name = name_override.value_or(kern.name);
+    gl_sharing_handles handles = capture_gl_sharing_handles();
 
-    if(!can_overlap_existing)
+    if(!deferred)
     {
-        for(const auto& v : shared->kernels)
-        {
-            for(const auto& [check_name, kern] : v)
-            {
-                if(check_name == name)
-                    throw std::runtime_error("Kernel with name " + check_name + " already exists");
-            }
-        }
+        created_context created = create_native_context(handles);
+
+        selected_device = created.selected_device;
+        platform_name = created.platform_name;
+        caps = created.caps;
+        native_context = created.native_context;
+        memory->device_global_mem_size = caps->global_mem_size;
+        register_tracker(native_context.data, memory);
+        return;
     }
 
-    std::map<std::string, cl::kernel, std::less<>>& which = shared->kernels.emplace_back();
-    which[name] = kern;
+    pending = std::make_shared<deferred_context_creation>();
+    pending->result = std::async(std::launch::async, [handles]()
+    {
+        return create_native_context(handles);
+    }).share();
 }
 
-void cl::context::register_kernel(std::shared_ptr<pending_kernel> pending, const std::string& name)
+void cl::context::ensure_created()
 {
-    std::scoped_lock lock(shared->mut);
+    if(pending == nullptr)
+        return;
 
-    shared->pending_kernels.push_back({name, std::move(pending)});
-}
+    ///rethrows if creation failed. Every copy of this context shares the result, and resolves it on its own first use
+    const created_context& created = pending->result.get();
 
-cl::kernel cl::context::fetch_kernel(std::string_view name)
-{
-    std::scoped_lock lock(shared->mut);
+    selected_device = created.selected_device;
+    platform_name = created.platform_name;
+    caps = created.caps;
+    native_context = created.native_context;
 
-    for(auto& v : shared->kernels)
+    std::call_once(pending->publish_tracker, [&]()
     {
-        for(auto& [key, val] : v)
         {
-            if(key == name)
-                return val;
+            std::scoped_lock guard(memory->mut);
+
+            memory->device_global_mem_size = caps->global_mem_size;
         }
-    }
 
-    throw std::runtime_error("no such kernel in context");
+        register_tracker(native_context.data, memory);
+    });
+
+    pending = nullptr;
 }
 
-void cl::context::remove_kernel(std::string_view name)
+bool cl::context::is_ready()
 {
-    std::scoped_lock lock(shared->mut);
+    if(pending == nullptr)
+        return true;
 
-    for(int i=0; i < (int)shared->kernels.size(); i++)
-    {
-        for(auto it = shared->kernels[i].begin(); it != shared->kernels[i].end();)
+    return pending->result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+const cl::device_caps& cl::context::get_caps()
+{
+    ensure_created();
+
+    return *caps;
+}
+
+cl::memory_snapshot cl::context::get_memory_snapshot()
+{
+    if(memory == nullptr)
+        return memory_snapshot();
+
+    return memory->snapshot();
+}
+
+void cl::context::register_program(cl::program& p)
+{
+    p.ensure_built();
+
+    std::scoped_lock lock(shared->mut);
+
+    std::map<std::string, cl::kernel, std::less<>>& which = shared->kernels.emplace_back();
+
+    for(auto& [name, kern] : p.async->built_kernels)
+    {
+        which[name] = kern;
+    }
+}
+
+void cl::context::replace_program(const std::vector<std::string>& previous_kernels, cl::program& p)
+{
+    p.ensure_built();
+
+    std::scoped_lock lock(shared->mut);
+
+    std::map<std::string, cl::kernel, std::less<>>* which = nullptr;
+
+    for(auto& kerns : shared->kernels)
+    {
+        for(const std::string& name : previous_kernels)
+        {
+            auto it = kerns.find(name);
+
+            if(it == kerns.end())
+                continue;
+
+            if(which == nullptr)
+                which = &kerns;
+
+            kerns.erase(it);
+        }
+    }
+
+    if(which == nullptr)
+        which = &shared->kernels.emplace_back();
+
+    for(auto& [name, kern] : p.async->built_kernels)
+    {
+        (*which)[name] = kern;
+    }
+}
+
+void cl::context::deregister_program(int idx)
+{
+    std::scoped_lock lock(shared->mut);
+
+    if(idx < 0 || idx >= (int)shared->kernels.size())
+        throw std::runtime_error("idx < 0 || idx >= kernels->size() in deregister_program for cl::context");
+
+    shared->kernels.erase(shared->kernels.begin() + idx);
+}
+
+void cl::context::register_kernel(const cl::kernel& kern, std::optional<std::string> name_override, bool can_overlap_existing)
+{
+    std::scoped_lock lock(shared->mut);
+
+    std::string name = name_override.value_or(kern.name);
+
+    if(!can_overlap_existing)
+    {
+        for(const auto& v : shared->kernels)
+        {
+            for(const auto& [check_name, kern] : v)
+            {
+                if(check_name == name)
+                    throw std::runtime_error("Kernel with name " + check_name + " already exists");
+            }
+        }
+    }
+
+    std::map<std::string, cl::kernel, std::less<>>& which = shared->kernels.emplace_back();
+    which[name] = kern;
+}
+
+void cl::context::register_kernel(std::shared_ptr<pending_kernel> pending, const std::string& name)
+{
+    std::scoped_lock lock(shared->mut);
+
+    shared->pending_kernels.push_back({name, std::move(pending)});
+}
+
+cl::kernel cl::context::fetch_kernel(std::string_view name)
+{
+    std::scoped_lock lock(shared->mut);
+
+    for(auto& v : shared->kernels)
+    {
+        for(auto& [key, val] : v)
+        {
+            if(key == name)
+                return val;
+        }
+    }
+
+    throw std::runtime_error("no such kernel in context");
+}
+
+void cl::context::remove_kernel(std::string_view name)
+{
+    std::scoped_lock lock(shared->mut);
+
+    for(int i=0; i < (int)shared->kernels.size(); i++)
+    {
+        for(auto it = shared->kernels[i].begin(); it != shared->kernels[i].end();)
         {
             if(it->first == name)
                 it = shared->kernels[i].erase(it);
@@ -409,6 +914,9 @@ void cl::async_build_and_cache(cl::context ctx, std::function<std::string(void)>
     }
 
     std::jthread([=] mutable {
+        ///a deferred context finishes being created off the calling thread, alongside generating the source
+        ctx.ensure_created();
+
         cl::program prog = cl::build_program_with_cache(ctx, {func()}, false, options);
         prog.ensure_built();
 
@@ -540,7 +1048,7 @@ void debug_build_status(cl_program prog, cl_device_id selected_device, const std
 
     std::cout << log << std::endl;
 
-    throw std::runtime_error("Failed to build");
+    throw std::runtime_error("Failed to build " + name + "\n" + log);
 }
 
 void debug_build_status(cl::program& prog)
@@ -574,78 +1082,87 @@ void cl::program::build(const context& ctx, const std::string& options)
 
     std::thread([prog, selected, build_options, async_ctx, options, cache_write, cache_name]()
     {
-
         async_setter sett(async_ctx);
 
-        if(async_ctx->cancelled)
-            return;
-
-        cl_int build_err = 0;
-
+        ///an exception escaping this thread would terminate the process, so failures are handed to whoever waits on the build
+        try
         {
-            ///serialise access to clbuildprogram so that you can perform cancellation
-            std::scoped_lock lock(build_mut);
 
             if(async_ctx->cancelled)
                 return;
 
-            build_err = clBuildProgram(prog.data, 1, &selected, build_options.c_str(), nullptr, nullptr);
-        }
+            cl_int build_err = 0;
 
-        if(build_err != CL_SUCCESS && build_err != CL_BUILD_PROGRAM_FAILURE)
-        {
-            if(build_err == -66)
             {
-                std::cout << "Failed to compile due to build options " << options << std::endl;
+                ///serialise access to clbuildprogram so that you can perform cancellation
+                std::scoped_lock lock(build_mut);
+
+                if(async_ctx->cancelled)
+                    return;
+
+                build_err = clBuildProgram(prog.data, 1, &selected, build_options.c_str(), nullptr, nullptr);
             }
 
-            std::cout << "Error in clBuildProgram " << build_err << std::endl;
-            throw std::runtime_error("Build Error " + std::to_string(build_err));
-        }
+            if(build_err != CL_SUCCESS && build_err != CL_BUILD_PROGRAM_FAILURE)
+            {
+                if(build_err == -66)
+                {
+                    std::cout << "Failed to compile due to build options " << options << std::endl;
+                }
 
-        if(async_ctx->cancelled)
-            return;
+                std::cout << "Error in clBuildProgram " << build_err << std::endl;
+                throw std::runtime_error("Build Error " + std::to_string(build_err));
+            }
 
-        debug_build_status(prog.data, selected, cache_name);
+            if(async_ctx->cancelled)
+                return;
 
-        cl_uint num = 0;
-        cl_int err = clCreateKernelsInProgram(prog.data, 0, nullptr, &num);
+            debug_build_status(prog.data, selected, cache_name);
 
-        if(err != CL_SUCCESS)
-        {
-            std::cout << "Error creating program " << err << std::endl;
-            throw std::runtime_error("Bad Program");
-        }
+            cl_uint num = 0;
+            cl_int err = clCreateKernelsInProgram(prog.data, 0, nullptr, &num);
 
-        if(async_ctx->cancelled)
-            return;
+            if(err != CL_SUCCESS)
+            {
+                std::cout << "Error creating program " << err << std::endl;
+                throw std::runtime_error("Bad Program");
+            }
 
-        std::vector<cl_kernel> cl_kernels;
-        cl_kernels.resize(num + 1);
+            if(async_ctx->cancelled)
+                return;
 
-        clCreateKernelsInProgram(prog.data, num, cl_kernels.data(), nullptr);
+            std::vector<cl_kernel> cl_kernels;
+            cl_kernels.resize(num + 1);
 
-        cl_kernels.resize(num);
+            clCreateKernelsInProgram(prog.data, num, cl_kernels.data(), nullptr);
 
-        if(num == 0)
-        {
-            printf("Warning, 0 kernels built\n");
-        }
+            cl_kernels.resize(num);
 
-        std::map<std::string, cl::kernel>& which = async_ctx->built_kernels;
+            if(num == 0)
+            {
+                printf("Warning, 0 kernels built\n");
+            }
 
-        for(cl_kernel k : cl_kernels)
-        {
-            cl::kernel k1(k);
+            std::map<std::string, cl::kernel>& which = async_ctx->built_kernels;
+
+            for(cl_kernel k : cl_kernels)
+            {
+                cl::kernel k1(k);
 
-            k1.name.resize(strlen(k1.name.c_str()));
+                k1.name.resize(strlen(k1.name.c_str()));
 
-            which[k1.name] = k1;
-        }
+                which[k1.name] = k1;
+            }
 
-        if(cache_write)
+            if(cache_write)
+            {
+                file::write("cache/" + cache_name, ::get_binary(prog), file::mode::BINARY);
+            }
+        }
+        catch(std::exception& e)
         {
-            file::write("cache/" + cache_name, ::get_binary(prog), file::mode::BINARY);
+            async_ctx->built_kernels.clear();
+            async_ctx->build_error = e.what();
         }
     }).detach();
 }
@@ -653,6 +1170,9 @@ void cl::program::build(const context& ctx, const std::string& options)
 void cl::program::ensure_built()
 {
     async->latch.wait();
+
+    if(async->build_error.has_value())
+        throw std::runtime_error(async->build_error.value());
 }
 
 bool cl::program::is_built()
@@ -672,124 +1192,413 @@ void hash_combine(std::size_t& seed, const T& v)
     std::hash<T> hasher;
     seed ^= hasher(v) + 0x9e3779b9 + (seed<<6) + (seed>>2);
 }
-}
 
-cl::program cl::build_program_with_cache(const context& ctx, const std::vector<std::string>& data, bool is_file, const std::string& options, const std::vector<std::string>& extra_deps, const std::string& cache_name)
+struct source_file_info
 {
-    assert(data.size() > 0);
+    std::filesystem::file_time_type mtime;
+    uintmax_t size = 0;
+    size_t hash = 0;
+    ///as written in the file, unresolved
+    std::vector<std::string> includes;
+};
 
-    std::vector<std::string> file_data;
+std::mutex source_info_mut;
+std::map<std::string, source_file_info> source_info_cache;
 
-    if(is_file)
+///the targets of every #include outside of comments and string literals. Conditional compilation is ignored, so this may over report
+std::vector<std::string> scan_includes(const std::string& src)
+{
+    std::string stripped;
+    stripped.reserve(src.size());
+
+    for(size_t i=0; i < src.size(); i++)
     {
-        for(auto& i : data)
+        if(src[i] == '/' && i + 1 < src.size() && src[i + 1] == '/')
         {
-            file_data.push_back(file::read(i, file::mode::BINARY));
+            while(i < src.size() && src[i] != '\n')
+                i++;
+
+            stripped.push_back('\n');
+        }
+        else if(src[i] == '/' && i + 1 < src.size() && src[i + 1] == '*')
+        {
+            i += 2;
+
+            while(i < src.size() && !(src[i] == '*' && i + 1 < src.size() && src[i + 1] == '/'))
+            {
+                if(src[i] == '\n')
+                    stripped.push_back('\n');
+
+                i++;
+            }
+
+            i++;
+            stripped.push_back(' ');
+        }
+        else if(src[i] == '"')
+        {
+            ///kept, as include names are string literals
+            stripped.push_back(src[i++]);
+
+            while(i < src.size() && src[i] != '"' && src[i] != '\n')
+            {
+                if(src[i] == '\\' && i + 1 < src.size())
+                    stripped.push_back(src[i++]);
+
+                stripped.push_back(src[i++]);
+            }
+
+            if(i < src.size())
+                stripped.push_back(src[i]);
+        }
+        else
+        {
+            stripped.push_back(src[i]);
         }
-    }
-    else
-    {
-        file_data = data;
     }
 
-    std::vector<std::string> deps_file_data;
+    std::vector<std::string> ret;
 
-    for(const auto& name : extra_deps)
+    size_t line_start = 0;
+
+    while(line_start < stripped.size())
     {
-        deps_file_data.push_back(file::read(name, file::mode::BINARY));
-    }
+        size_t line_end = stripped.find('\n', line_start);
 
-    std::optional<cl::program> prog_opt;
+        if(line_end == std::string::npos)
+            line_end = stripped.size();
 
-    std::size_t hsh = 0;
+        std::string_view line(stripped.data() + line_start, line_end - line_start);
 
-    hash_combine(hsh, options);
+        line_start = line_end + 1;
 
-    for(auto& i : file_data)
-        hash_combine(hsh, i);
+        auto skip_space = [&](size_t idx)
+        {
+            while(idx < line.size() && (line[idx] == ' ' || line[idx] == '\t'))
+                idx++;
 
-    for(const auto& file : deps_file_data)
-        hash_combine(hsh, file);
+            return idx;
+        };
 
-    hash_combine(hsh, ctx.platform_name);
+        size_t idx = skip_space(0);
 
-    auto d_name_as_vec = get_device_info(ctx.selected_device, CL_DEVICE_NAME);
+        if(idx >= line.size() || line[idx] != '#')
+            continue;
 
-    hash_combine(hsh, std::string(d_name_as_vec.begin(), d_name_as_vec.end()));
+        idx = skip_space(idx + 1);
 
-    file::mkdir("cache");
+        if(line.substr(idx, 7) != "include")
+            continue;
 
-    std::string filename;
+        idx = skip_space(idx + 7);
 
-    if(is_file)
-    {
-        for(auto& i : data)
-            filename += i + "_";
-    }
-    else
-    {
-        filename = "";
-    }
+        if(idx >= line.size())
+            continue;
 
-    std::string name_in_cache = filename + std::to_string(hsh);
+        char close = line[idx] == '<' ? '>' : '"';
 
-    if(cache_name != "")
-    {
-        name_in_cache = cache_name + "_" + std::to_string(hsh);
-    }
+        if(line[idx] != '<' && line[idx] != '"')
+            continue;
 
-    if(file::exists("cache/" + name_in_cache))
-    {
-        std::string bin = file::read("cache/" + name_in_cache, file::mode::BINARY);
+        size_t end = line.find(close, idx + 1);
 
-        prog_opt.emplace(ctx, bin, cl::program::binary_tag{});
+        if(end == std::string_view::npos)
+            continue;
+
+        ret.push_back(std::string(line.substr(idx + 1, end - idx - 1)));
     }
-    else
+
+    return ret;
+}
+
+///memoised by (path, mtime, size), so that unchanged files are only stat'd rather than read. nullopt if the file doesn't exist
+std::optional<source_file_info> get_source_file_info(const std::string& path)
+{
+    std::error_code ec;
+
+    auto mtime = std::filesystem::last_write_time(path, ec);
+
+    if(ec)
+        return std::nullopt;
+
+    uintmax_t size = std::filesystem::file_size(path, ec);
+
+    if(ec)
+        return std::nullopt;
+
     {
-        prog_opt.emplace(ctx, file_data, false);
-        prog_opt.value().must_write_to_cache_when_built = true;
-        prog_opt.value().name_in_cache = name_in_cache;
+        std::scoped_lock guard(source_info_mut);
+
+        if(auto it = source_info_cache.find(path); it != source_info_cache.end() && it->second.mtime == mtime && it->second.size == size)
+            return it->second;
     }
 
-    if(!is_file && file_data.size() == 1)
-    {
-        file::mkdir("generated");
+    std::string data = file::read(path, file::mode::BINARY);
 
-        std::string full_name = "generated/" + name_in_cache + ".cl";
+    source_file_info info;
+    info.mtime = mtime;
+    info.size = size;
+    info.hash = std::hash<std::string>()(data);
+    info.includes = scan_includes(data);
 
-        bool should_update = true;
+    std::scoped_lock guard(source_info_mut);
 
-        if(file::exists(full_name) && file::read(full_name, file::mode::TEXT) == file_data[0])
-            should_update = false;
+    source_info_cache[path] = info;
 
-        if(should_update)
-            file::write(full_name, file_data[0], file::mode::TEXT);
-    }
+    return info;
+}
 
-    cl::program& t_program = prog_opt.value();
+std::vector<std::string> get_include_paths(const std::string& options)
+{
+    std::vector<std::string> tokens;
+    std::string current;
 
-    try
+    for(char c : options)
     {
-        t_program.build(ctx, options);
+        if(c == ' ' || c == '\t' || c == '\n')
+        {
+            if(current.size() > 0)
+                tokens.push_back(current);
+
+            current.clear();
+        }
+        else if(c != '"')
+        {
+            current.push_back(c);
+        }
     }
-    catch(...)
+
+    if(current.size() > 0)
+        tokens.push_back(current);
+
+    std::vector<std::string> ret;
+
+    for(int i=0; i < (int)tokens.size(); i++)
     {
-        std::cout << "Error building " << filename << std::endl;
-        throw;
+        if(tokens[i] == "-I" && i + 1 < (int)tokens.size())
+            ret.push_back(tokens[++i]);
+        else if(tokens[i].starts_with("-I"))
+            ret.push_back(tokens[i].substr(2));
     }
 
-    return t_program;
+    return ret;
 }
 
-cl_mem_flags cl::mem_object::get_flags()
+///the including file's directory first, then the -I paths, as the opencl compiler searches them
+std::optional<std::string> resolve_include(const std::string& name, const std::filesystem::path& from_dir, const std::vector<std::string>& include_paths)
 {
-    return cl::get_flags(*this);
-}
+    std::error_code ec;
 
-std::optional<cl::mem_object> cl::mem_object::get_parent()
-{
-    return cl::get_parent(*this);
-}
+    std::filesystem::path local = from_dir / name;
+
+    if(std::filesystem::is_regular_file(local, ec))
+        return local.lexically_normal().generic_string();
+
+    for(const std::string& dir : include_paths)
+    {
+        std::filesystem::path candidate = std::filesystem::path(dir) / name;
+
+        if(std::filesystem::is_regular_file(candidate, ec))
+            return candidate.lexically_normal().generic_string();
+    }
+
+    return std::nullopt;
+}
+
+void collect_includes(const std::vector<std::string>& includes, const std::filesystem::path& from_dir, const std::vector<std::string>& include_paths, std::set<std::string>& seen, std::vector<std::string>& out)
+{
+    for(const std::string& name : includes)
+    {
+        std::optional<std::string> resolved = resolve_include(name, from_dir, include_paths);
+
+        ///builtin or system headers
+        if(!resolved.has_value())
+            continue;
+
+        if(!seen.insert(resolved.value()).second)
+            continue;
+
+        std::optional<source_file_info> info = get_source_file_info(resolved.value());
+
+        if(!info.has_value())
+            continue;
+
+        out.push_back(resolved.value());
+
+        collect_includes(info.value().includes, std::filesystem::path(resolved.value()).parent_path(), include_paths, seen, out);
+    }
+}
+}
+
+std::vector<std::string> cl::get_include_dependencies(const std::vector<std::string>& data, bool is_file, const std::string& options)
+{
+    std::vector<std::string> include_paths = get_include_paths(options);
+
+    std::set<std::string> seen;
+    std::vector<std::string> ret;
+
+    for(const std::string& i : data)
+    {
+        if(is_file)
+        {
+            seen.insert(std::filesystem::path(i).lexically_normal().generic_string());
+
+            std::optional<source_file_info> info = get_source_file_info(i);
+
+            if(!info.has_value())
+                throw std::runtime_error("No such file " + i);
+
+            collect_includes(info.value().includes, std::filesystem::path(i).parent_path(), include_paths, seen, ret);
+        }
+        else
+        {
+            collect_includes(scan_includes(i), ".", include_paths, seen, ret);
+        }
+    }
+
+    return ret;
+}
+
+cl::program cl::build_program_with_cache(const context& ctx, const std::vector<std::string>& data, bool is_file, const std::string& options, const std::vector<std::string>& extra_deps, const std::string& cache_name)
+{
+    assert(data.size() > 0);
+
+    std::optional<cl::program> prog_opt;
+
+    std::size_t hsh = 0;
+
+    hash_combine(hsh, options);
+
+    ///files are hashed through the (path, mtime, size) memo, and only read if the binary isn't cached
+    if(is_file)
+    {
+        for(auto& i : data)
+        {
+            std::optional<source_file_info> info = get_source_file_info(i);
+
+            if(!info.has_value())
+                throw std::runtime_error("No such file " + i);
+
+            hash_combine(hsh, info.value().hash);
+        }
+    }
+    else
+    {
+        for(auto& i : data)
+            hash_combine(hsh, i);
+    }
+
+    ///a dependency which can't be read would otherwise hash the same as any other missing file, and reuse a stale binary
+    auto hash_dependency = [&](const std::string& name)
+    {
+        std::optional<source_file_info> info = get_source_file_info(name);
+
+        if(!info.has_value())
+            throw std::runtime_error("Could not read dependency " + name);
+
+        hash_combine(hsh, info.value().hash);
+    };
+
+    for(const std::string& name : get_include_dependencies(data, is_file, options))
+    {
+        hash_combine(hsh, name);
+        hash_dependency(name);
+    }
+
+    for(const auto& name : extra_deps)
+        hash_dependency(name);
+
+    hash_combine(hsh, ctx.platform_name);
+
+    assert(ctx.caps);
+
+    hash_combine(hsh, ctx.caps->name);
+
+    file::mkdir("cache");
+
+    std::string filename;
+
+    if(is_file)
+    {
+        for(auto& i : data)
+            filename += i + "_";
+    }
+    else
+    {
+        filename = "";
+    }
+
+    std::string name_in_cache = filename + std::to_string(hsh);
+
+    if(cache_name != "")
+    {
+        name_in_cache = cache_name + "_" + std::to_string(hsh);
+    }
+
+    if(file::exists("cache/" + name_in_cache))
+    {
+        std::string bin = file::read("cache/" + name_in_cache, file::mode::BINARY);
+
+        prog_opt.emplace(ctx, bin, cl::program::binary_tag{});
+    }
+    else
+    {
+        std::vector<std::string> file_data;
+
+        if(is_file)
+        {
+            for(auto& i : data)
+                file_data.push_back(file::read(i, file::mode::BINARY));
+        }
+        else
+        {
+            file_data = data;
+        }
+
+        prog_opt.emplace(ctx, file_data, false);
+        prog_opt.value().must_write_to_cache_when_built = true;
+        prog_opt.value().name_in_cache = name_in_cache;
+    }
+
+    if(!is_file && data.size() == 1)
+    {
+        file::mkdir("generated");
+
+        std::string full_name = "generated/" + name_in_cache + ".cl";
+
+        bool should_update = true;
+
+        if(file::exists(full_name) && file::read(full_name, file::mode::TEXT) == data[0])
+            should_update = false;
+
+        if(should_update)
+            file::write(full_name, data[0], file::mode::TEXT);
+    }
+
+    cl::program& t_program = prog_opt.value();
+
+    try
+    {
+        t_program.build(ctx, options);
+    }
+    catch(...)
+    {
+        std::cout << "Error building " << filename << std::endl;
+        throw;
+    }
+
+    return t_program;
+}
+
+cl_mem_flags cl::mem_object::get_flags()
+{
+    return cl::get_flags(*this);
+}
+
+std::optional<cl::mem_object> cl::mem_object::get_parent()
+{
+    return cl::get_parent(*this);
+}
 
 std::optional<cl::mem_object> cl::get_parent(const cl::mem_object& in)
 {
@@ -863,6 +1672,8 @@ std::pair<cl::mem_object, cl_mem_flags> get_barrier_vars(const cl::mem_object& i
 
 cl::buffer::buffer(cl::context& ctx)
 {
+    ctx.ensure_created();
+
     native_context = ctx.native_context;
 }
 
@@ -879,11 +1690,176 @@ void cl::buffer::alloc(int64_t bytes)
 
     if(err != CL_SUCCESS)
     {
+        std::shared_ptr<memory_tracker> memory = find_tracker(native_context.data);
+        std::string live = memory ? std::to_string(memory->snapshot().live_bytes) : "unknown";
+
         std::cout << "Error allocating buffer" << std::endl;
-        throw std::runtime_error("Could not allocate buffer");
+        throw std::runtime_error("Could not allocate buffer of " + std::to_string(bytes) + " bytes with tag " + tag_or_default(memory_tag) + ", live bytes " + live + ", error " + std::to_string(err));
     }
 
+    track_allocation(native_context.data, found, memory_tag, false);
+
     native_mem_object.consume(found);
+
+    ///a fresh cache rather than clearing the old one, which other handles to the previous allocation still share
+    views = std::make_shared<sub_buffer_cache>();
+}
+
+namespace
+{
+    ///keeps the per buffer maps from growing without bound as buffers come and go
+    void prune_finished(std::map<cl_mem, cl::event>& events)
+    {
+        if(events.size() < 64)
+            return;
+
+        for(auto it = events.begin(); it != events.end();)
+        {
+            if(it->second.is_finished())
+                it = events.erase(it);
+            else
+                it++;
+        }
+    }
+
+    ///views made by slice and as_props are separate cl_mems over the same storage, so transfers are ordered against the allocation they belong to
+    cl_mem root_allocation(cl_mem mem)
+    {
+        while(mem != nullptr)
+        {
+            cl_mem parent = nullptr;
+
+            if(clGetMemObjectInfo(mem, CL_MEM_ASSOCIATED_MEMOBJECT, sizeof(cl_mem), &parent, nullptr) != CL_SUCCESS || parent == nullptr)
+                break;
+
+            mem = parent;
+        }
+
+        return mem;
+    }
+
+    ///the routed transfer on mem which something enqueued directly on cqueue has to wait for
+    std::vector<cl_event> pending_transfer(cl::command_queue& cqueue, cl_mem mem)
+    {
+        if(!cqueue.transfer)
+            return {};
+
+        mem = root_allocation(mem);
+
+        std::scoped_lock guard(cqueue.transfer->mut);
+
+        auto it = cqueue.transfer->last_transfer.find(mem);
+
+        if(it == cqueue.transfer->last_transfer.end())
+            return {};
+
+        return to_raw_events({it->second});
+    }
+
+    ///returns the queue a transfer touching mems should be enqueued on, and adds the kernels it must wait for to deps
+    cl::command_queue& begin_transfer(cl::command_queue& cqueue, std::initializer_list<cl_mem> mems, std::vector<cl::event>& deps)
+    {
+        if(!cqueue.transfer)
+            return cqueue;
+
+        bool waits_on_compute = false;
+
+        {
+            std::scoped_lock guard(cqueue.transfer->mut);
+
+            for(cl_mem mem : mems)
+            {
+                auto it = cqueue.transfer->last_compute.find(root_allocation(mem));
+
+                if(it == cqueue.transfer->last_compute.end())
+                    continue;
+
+                deps.push_back(it->second);
+                waits_on_compute = true;
+            }
+        }
+
+        ///events from another queue are only guaranteed to make progress once that queue is flushed
+        if(waits_on_compute)
+            clFlush(cqueue.native_command_queue.data);
+
+        return cqueue.transfer->queue;
+    }
+
+    void end_transfer(cl::command_queue& cqueue, std::initializer_list<cl_mem> mems, const cl::event& evt)
+    {
+        if(!cqueue.transfer)
+            return;
+
+        {
+            std::scoped_lock guard(cqueue.transfer->mut);
+
+            for(cl_mem mem : mems)
+                cqueue.transfer->last_transfer[root_allocation(mem)] = evt;
+
+            prune_finished(cqueue.transfer->last_transfer);
+        }
+
+        clFlush(cqueue.transfer->queue.native_command_queue.data);
+    }
+
+    ///for copies which stay on cqueue, as images may be gl objects acquired there. Waits for routed transfers on mems, on top of events
+    std::vector<cl_event> ordered_on_compute(cl::command_queue& cqueue, std::initializer_list<cl_mem> mems, const std::vector<cl::event>& events)
+    {
+        std::vector<cl_event> raw_events = to_raw_events(events);
+
+        for(cl_mem mem : mems)
+        {
+            std::vector<cl_event> transfer_events = pending_transfer(cqueue, mem);
+
+            raw_events.insert(raw_events.end(), transfer_events.begin(), transfer_events.end());
+        }
+
+        return raw_events;
+    }
+
+    ///so that later routed transfers on mems wait for evt, as they do for kernels
+    void record_on_compute(cl::command_queue& cqueue, std::initializer_list<cl_mem> mems, const cl::event& evt)
+    {
+        if(!cqueue.transfer)
+            return;
+
+        for(cl_mem mem : mems)
+            cl::record_compute_use(cqueue.transfer.get(), mem, evt);
+    }
+}
+
+cl::transfer_route* cl::get_transfer_deps(cl::command_queue& cqueue, cl_mem mem, std::vector<cl::event>& deps)
+{
+    if(!cqueue.transfer)
+        return nullptr;
+
+    mem = root_allocation(mem);
+
+    std::scoped_lock guard(cqueue.transfer->mut);
+
+    auto it = cqueue.transfer->last_transfer.find(mem);
+
+    if(it != cqueue.transfer->last_transfer.end())
+        deps.push_back(it->second);
+
+    return cqueue.transfer.get();
+}
+
+void cl::record_compute_use(cl::transfer_route* route, cl_mem mem, const cl::event& evt)
+{
+    mem = root_allocation(mem);
+
+    std::scoped_lock guard(route->mut);
+
+    route->last_compute[mem] = evt;
+
+    prune_finished(route->last_compute);
+}
+
+cl::transfer_route::transfer_route(cl::context& ctx) : queue(ctx)
+{
+
 }
 
 cl::event cl::buffer::write(cl::command_queue& write_on, const char* ptr, int64_t bytes, int64_t offset)
@@ -892,7 +1868,9 @@ cl::event cl::buffer::write(cl::command_queue& write_on, const char* ptr, int64_
 
     cl::event evt;
 
-    cl_int val = clEnqueueWriteBuffer(write_on.native_command_queue.data, native_mem_object.data, CL_TRUE, offset, bytes, ptr, 0, nullptr, &evt.native_event.data);
+    std::vector<cl_event> events = pending_transfer(write_on, native_mem_object.data);
+
+    cl_int val = clEnqueueWriteBuffer(write_on.native_command_queue.data, native_mem_object.data, CL_TRUE, offset, bytes, ptr, events.size(), events.data(), &evt.native_event.data);
 
     if(val != CL_SUCCESS)
     {
@@ -915,7 +1893,7 @@ void event_memory_free(cl_event event, cl_int event_command_status, void* user_d
     delete [] (char*)user_data;
 }
 
-cl::event cl::buffer::write_async(cl::command_queue& write_on, const char* ptr, int64_t bytes)
+cl::event cl::buffer::write_async(cl::command_queue& write_on, const char* ptr, int64_t bytes, const std::vector<cl::event>& deps)
 {
     assert(bytes <= alloc_size);
 
@@ -925,15 +1903,22 @@ cl::event cl::buffer::write_async(cl::command_queue& write_on, const char* ptr,
 
     memcpy(nptr, ptr, bytes);
 
-    cl_int val = clEnqueueWriteBuffer(write_on.native_command_queue.data, native_mem_object.data, CL_FALSE, 0, bytes, nptr, 0, nullptr, &evt.native_event.data);
+    std::vector<cl::event> wait_on = deps;
+    cl::command_queue& queue = begin_transfer(write_on, {native_mem_object.data}, wait_on);
+    std::vector<cl_event> events = to_raw_events(wait_on);
 
-    clSetEventCallback(evt.native_event.data, CL_COMPLETE, &event_memory_free, nptr);
+    cl_int val = clEnqueueWriteBuffer(queue.native_command_queue.data, native_mem_object.data, CL_FALSE, 0, bytes, nptr, events.size(), events.data(), &evt.native_event.data);
 
     if(val != CL_SUCCESS)
     {
+        delete [] nptr;
         throw std::runtime_error("Could not write");
     }
 
+    clSetEventCallback(evt.native_event.data, CL_COMPLETE, &event_memory_free, nptr);
+
+    end_transfer(write_on, {native_mem_object.data}, evt);
+
     return evt;
 }
 
@@ -946,7 +1931,9 @@ void cl::buffer::read(cl::command_queue& read_on, char* ptr, int64_t bytes, int6
 {
     assert((bytes + offset) <= alloc_size);
 
-    cl_int val = clEnqueueReadBuffer(read_on.native_command_queue.data, native_mem_object.data, CL_TRUE, offset, bytes, ptr, 0, nullptr, nullptr);
+    std::vector<cl_event> events = pending_transfer(read_on, native_mem_object.data);
+
+    cl_int val = clEnqueueReadBuffer(read_on.native_command_queue.data, native_mem_object.data, CL_TRUE, offset, bytes, ptr, events.size(), events.data(), nullptr);
 
     if(val != CL_SUCCESS)
     {
@@ -958,17 +1945,21 @@ cl::event cl::buffer::read_async(cl::command_queue& read_on, char* ptr, int64_t
 {
     assert(bytes <= alloc_size);
 
-    std::vector<cl_event> evts = to_raw_events(wait_on);
-;
+    std::vector<cl::event> deps = wait_on;
+    cl::command_queue& queue = begin_transfer(read_on, {native_mem_object.data}, deps);
+    std::vector<cl_event> evts = to_raw_events(deps);
+
     cl::event evt;
 
-    cl_int val = clEnqueueReadBuffer(read_on.native_command_queue.data, native_mem_object.data, CL_FALSE, 0, bytes, ptr, evts.size(), evts.data(), &evt.native_event.data);
+    cl_int val = clEnqueueReadBuffer(queue.native_command_queue.data, native_mem_object.data, CL_FALSE, 0, bytes, ptr, evts.size(), evts.data(), &evt.native_event.data);
 
     if(val != CL_SUCCESS)
     {
         throw std::runtime_error("Could not read_async " + std::to_string(val));
     }
 
+    end_transfer(read_on, {native_mem_object.data}, evt);
+
     return evt;
 }
 
@@ -986,7 +1977,7 @@ cl::event cl::buffer::fill(cl::command_queue& write_on, const void* pattern, siz
     if(size == 0)
         return evt;
 
-    std::vector<cl_event> events = to_raw_events(deps);
+    std::vector<cl_event> events = ordered_on_compute(write_on, {native_mem_object.data}, deps);
 
     cl_int val = clEnqueueFillBuffer(write_on.native_command_queue.data, native_mem_object.data, pattern, pattern_size, 0, size, events.size(), events.data(), &evt.native_event.data);
 
@@ -995,19 +1986,62 @@ cl::event cl::buffer::fill(cl::command_queue& write_on, const void* pattern, siz
         throw std::runtime_error("Could not fill buffer " + std::to_string(val));
     }
 
+    record_on_compute(write_on, {native_mem_object.data}, evt);
+
     return evt;
 }
 
+struct cl::sub_buffer_cache
+{
+    std::mutex mut;
+    std::map<std::tuple<size_t, size_t, cl_mem_flags>, cl::buffer> views;
+    ///0 until queried
+    int64_t base_align_bytes = 0;
+};
+
 ///I think it might be better to simply mark buffers
 namespace
 {
-    cl::buffer as_props(cl::buffer& in, cl_mem_flags flags, cl_buffer_region region)
+    ///views at arbitrary offsets would otherwise accumulate forever, eg slices of a ring buffer
+    constexpr size_t max_cached_views = 256;
+
+    int64_t query_base_align_bytes(cl_context ctx)
     {
-        cl::buffer ret = in;
+        size_t device_bytes = 0;
+
+        CHECK(clGetContextInfo(ctx, CL_CONTEXT_DEVICES, 0, nullptr, &device_bytes));
+
+        std::vector<cl_device_id> devices(device_bytes / sizeof(cl_device_id));
+
+        CHECK(clGetContextInfo(ctx, CL_CONTEXT_DEVICES, device_bytes, devices.data(), nullptr));
 
-        assert(region.origin >= 0);
+        int64_t align = 1;
+
+        for(cl_device_id id : devices)
+        {
+            align = std::max<int64_t>(align, cl::get_device_caps(id)->mem_base_addr_align);
+        }
+
+        return align;
+    }
+
+    cl::buffer as_props(cl::buffer& in, cl_mem_flags flags, cl_buffer_region region)
+    {
         assert(region.origin + region.size <= (size_t)in.alloc_size);
 
+        if(!in.views)
+            in.views = std::make_shared<cl::sub_buffer_cache>();
+
+        std::scoped_lock guard(in.views->mut);
+
+        auto key = std::tuple{region.origin, region.size, flags};
+
+        if(auto it = in.views->views.find(key); it != in.views->views.end())
+            return it->second;
+
+        cl::buffer ret = in;
+        ret.views = nullptr;
+
         cl_int err = 0;
         cl_mem as_subobject = clCreateSubBuffer(in.native_mem_object.data, flags, CL_BUFFER_CREATE_TYPE_REGION, &region, &err);
 
@@ -1019,6 +2053,11 @@ namespace
         ret.native_mem_object.consume(as_subobject);
         ret.alloc_size = region.size;
 
+        if(in.views->views.size() >= max_cached_views)
+            in.views->views.clear();
+
+        in.views->views.emplace(key, ret);
+
         return ret;
     }
 
@@ -1061,17 +2100,423 @@ cl::buffer cl::buffer::as_device_inaccessible()
     return buf;
 }
 
-cl::buffer cl::buffer::slice(int64_t offset, int64_t length, cl_mem_flags flags)
-{
-    cl_buffer_region region;
-    region.origin = offset;
-    region.size = length;
+cl::event cl::buffer::write_as_half(cl::command_queue& write_on, std::span<const float> data)
+{
+    if(data.size() == 0)
+        return cl::event();
+
+    std::vector<uint16_t> converted(data.size());
+
+    pixel::float_to_half(data.data(), converted.data(), data.size());
+
+    return write(write_on, (const char*)converted.data(), converted.size() * sizeof(uint16_t));
+}
+
+std::vector<float> cl::buffer::read_half_as_float(cl::command_queue& read_on)
+{
+    assert((alloc_size % sizeof(uint16_t)) == 0);
+
+    std::vector<uint16_t> raw(alloc_size / sizeof(uint16_t));
+    std::vector<float> ret(raw.size());
+
+    if(raw.size() == 0)
+        return ret;
+
+    read(read_on, (char*)raw.data(), alloc_size);
+
+    pixel::half_to_float(raw.data(), ret.data(), raw.size());
+
+    return ret;
+}
+
+cl::buffer cl::buffer::slice(int64_t offset, int64_t length, cl_mem_flags flags)
+{
+    assert(offset >= 0 && length >= 0);
+
+    if(int64_t align = get_sub_buffer_alignment(); (offset % align) != 0)
+        throw std::runtime_error("Slice offset " + std::to_string(offset) + " is not a multiple of the device's base address alignment of " + std::to_string(align) + " bytes");
+
+    cl_buffer_region region;
+    region.origin = offset;
+    region.size = length;
+
+    return as_props(*this, flags, region);
+}
+
+int64_t cl::buffer::get_sub_buffer_alignment()
+{
+    if(!views)
+        views = std::make_shared<sub_buffer_cache>();
+
+    std::scoped_lock guard(views->mut);
+
+    if(views->base_align_bytes == 0)
+        views->base_align_bytes = query_base_align_bytes(native_context.data);
+
+    return views->base_align_bytes;
+}
+
+namespace
+{
+std::atomic<uint64_t> next_exec_id{1};
+
+void CL_CALLBACK free_spilled_vector(cl_event event, cl_int event_command_status, void* user_data)
+{
+    delete (std::vector<char>*)user_data;
+}
+
+int64_t managed_budget(cl::managed_pool& pool)
+{
+    if(pool.budget_bytes > 0)
+        return pool.budget_bytes;
+
+    if(pool.memory == nullptr || pool.memory->device_global_mem_size == 0)
+        return std::numeric_limits<int64_t>::max();
+
+    return pool.memory->device_global_mem_size * 0.9;
+}
+
+int64_t live_device_bytes(cl::managed_pool& pool)
+{
+    if(pool.memory == nullptr)
+        return 0;
+
+    std::scoped_lock guard(pool.memory->mut);
+
+    return pool.memory->live_bytes;
+}
+
+///frees the spilled contents, once any readback into them has finished. Requires the pool lock
+void release_host_locked(cl::managed_buffer::state& st)
+{
+    if(st.evicting.is_finished())
+    {
+        st.host = std::vector<char>();
+        return;
+    }
+
+    std::vector<char>* in_flight = new std::vector<char>(std::move(st.host));
+    st.host = std::vector<char>();
+
+    st.evicting.set_completion_callback(&free_spilled_vector, in_flight);
+    st.evicting = cl::event();
+}
+
+///requires the pool lock. Returns the number of device bytes released
+///the readback is only enqueued, so that other allocations aren't held up behind it. Anything which touches st.host waits on st.evicting
+int64_t evict_locked(cl::managed_pool& pool, cl::managed_buffer::state& st, cl::command_queue& cqueue)
+{
+    if(!st.device.has_value())
+        return 0;
+
+    st.host.resize(st.alloc_size);
+
+    std::vector<cl_event> evts = to_raw_events({st.last_use});
+
+    cl::event readback;
+
+    if(st.alloc_size > 0)
+    {
+        cl_int err = clEnqueueReadBuffer(cqueue.native_command_queue.data, st.device->native_mem_object.data, CL_FALSE, 0, st.alloc_size, st.host.data(), evts.size(), evts.data(), &readback.native_event.data);
+
+        if(err != CL_SUCCESS)
+            throw std::runtime_error("Could not evict managed buffer, with error " + std::to_string(err));
+
+        clFlush(cqueue.native_command_queue.data);
+    }
+
+    ///the driver keeps the device allocation alive until the readback has finished with it
+    st.device = std::nullopt;
+    st.evicting = readback;
+    st.last_use = cl::event();
+    pool.evictions++;
+
+    return st.alloc_size;
+}
+
+///evicts the least recently used resident buffer which isn't an argument to exec_id. Requires the pool lock
+int64_t evict_one_locked(cl::managed_pool& pool, cl::command_queue& cqueue, uint64_t exec_id, cl::event* readback = nullptr)
+{
+    std::shared_ptr<cl::managed_buffer::state> oldest;
+
+    for(auto it = pool.buffers.begin(); it != pool.buffers.end();)
+    {
+        std::shared_ptr<cl::managed_buffer::state> st = it->lock();
+
+        if(st == nullptr)
+        {
+            it = pool.buffers.erase(it);
+            continue;
+        }
+
+        it++;
+
+        if(!st->device.has_value())
+            continue;
+
+        if(exec_id != 0 && st->locked_by_exec == exec_id)
+            continue;
+
+        if(oldest == nullptr || st->last_use_tick < oldest->last_use_tick)
+            oldest = st;
+    }
+
+    if(oldest == nullptr)
+        return 0;
+
+    int64_t released = evict_locked(pool, *oldest, cqueue);
+
+    if(readback)
+        *readback = oldest->evicting;
+
+    return released;
+}
+
+struct callback_helper_managed : cl::callback_helper_base
+{
+    cl::managed_buffer buf;
+    std::optional<cl::buffer> resident;
+
+    callback_helper_managed(const cl::managed_buffer& in) : buf(in){}
+
+    void prepare(cl::command_queue& cqueue, std::vector<cl::event>& deps, uint64_t exec_id) override
+    {
+        resident = buf.make_resident(cqueue, deps, exec_id);
+    }
+
+    void callback(cl_kernel kern, int idx) override
+    {
+        if(!resident.has_value())
+            throw std::runtime_error("A managed_buffer must be passed to command_queue::exec by kernel name, so that it can be made resident");
+
+        clSetKernelArg(kern, idx, sizeof(cl_mem), &resident->native_mem_object.data);
+    }
+
+    void used(const cl::event& evt) override
+    {
+        std::scoped_lock guard(buf.pool->mut);
+
+        buf.data->last_use = evt;
+    }
+};
+}
+
+void cl::args::push_back(const managed_buffer& val)
+{
+    arg_list.push_back(std::make_unique<callback_helper_managed>(val));
+}
+
+cl::managed_buffer::state::~state()
+{
+    if(!evicting.is_finished())
+        release_host_locked(*this);
+}
+
+cl::managed_buffer::managed_buffer(cl::context& _ctx) : ctx(_ctx)
+{
+    data = std::make_shared<state>();
+    data->memory_tag = "managed";
+    pool = ctx.managed;
+
+    if(pool == nullptr)
+    {
+        pool = std::make_shared<managed_pool>();
+        pool->memory = ctx.memory;
+    }
+
+    std::scoped_lock guard(pool->mut);
+
+    pool->buffers.push_back(data);
+}
+
+void cl::managed_buffer::alloc(int64_t bytes)
+{
+    assert(bytes >= 0);
+
+    std::scoped_lock guard(pool->mut);
+
+    data->device = std::nullopt;
+    release_host_locked(*data);
+    data->alloc_size = bytes;
+    data->last_use = cl::event();
+}
+
+int64_t cl::managed_buffer::alloc_size() const
+{
+    return data->alloc_size;
+}
+
+bool cl::managed_buffer::is_resident()
+{
+    std::scoped_lock guard(pool->mut);
+
+    return data->device.has_value();
+}
+
+cl::buffer cl::managed_buffer::make_resident(cl::command_queue& cqueue, std::vector<cl::event>& deps, uint64_t exec_id)
+{
+    std::scoped_lock guard(pool->mut);
+
+    data->last_use_tick = ++pool->tick;
+    data->locked_by_exec = exec_id;
+
+    if(data->device.has_value())
+        return data->device.value();
+
+    ///the memory tracker only drops an allocation once the driver has destroyed it, so count what we've released ourselves
+    int64_t budget = managed_budget(*pool);
+    int64_t released = 0;
+
+    while(live_device_bytes(*pool) - released + data->alloc_size > budget)
+    {
+        int64_t evicted = evict_one_locked(*pool, cqueue, exec_id);
+
+        if(evicted == 0)
+            break;
+
+        released += evicted;
+    }
+
+    cl::buffer buf(ctx);
+    buf.memory_tag = data->memory_tag;
+
+    while(true)
+    {
+        try
+        {
+            buf.alloc(data->alloc_size);
+            break;
+        }
+        catch(std::runtime_error& e)
+        {
+            cl::event readback;
+
+            if(evict_one_locked(*pool, cqueue, exec_id, &readback) == 0)
+                throw;
+
+            ///the evicted allocation is only freed once its readback completes. Out of memory is rare enough to wait for it under the lock
+            readback.block();
+        }
+    }
+
+    if(data->host.size() > 0)
+    {
+        ///the spilled copy is freed once the upload completes
+        std::vector<char>* spilled = new std::vector<char>(std::move(data->host));
+        data->host = std::vector<char>();
+
+        cl::event upload;
+
+        ///moving the vector keeps its storage, so the upload only has to be ordered after an unfinished eviction on the device
+        std::vector<cl_event> evts = to_raw_events({data->evicting});
+        data->evicting = cl::event();
+
+        cl_int err = clEnqueueWriteBuffer(cqueue.native_command_queue.data, buf.native_mem_object.data, CL_FALSE, 0, spilled->size(), spilled->data(), evts.size(), evts.data(), &upload.native_event.data);
+
+        if(err != CL_SUCCESS)
+        {
+            delete spilled;
+            throw std::runtime_error("Could not upload managed buffer, with error " + std::to_string(err));
+        }
+
+        clSetEventCallback(upload.native_event.data, CL_COMPLETE, &free_spilled_vector, spilled);
+
+        deps.push_back(upload);
+        data->last_use = upload;
+        pool->uploads++;
+    }
+
+    data->device = buf;
+
+    return buf;
+}
+
+void cl::managed_buffer::evict(cl::command_queue& cqueue)
+{
+    std::scoped_lock guard(pool->mut);
+
+    evict_locked(*pool, *data, cqueue);
+}
+
+cl::event cl::managed_buffer::write(cl::command_queue& write_on, const char* ptr, int64_t bytes)
+{
+    assert(bytes <= alloc_size());
+
+    ///a full overwrite doesn't need the spilled contents uploading first
+    if(bytes == alloc_size())
+    {
+        std::scoped_lock guard(pool->mut);
+
+        release_host_locked(*data);
+    }
+
+    std::vector<cl::event> deps;
+    cl::buffer buf = make_resident(write_on, deps);
+
+    std::vector<cl_event> evts = to_raw_events(deps);
+
+    cl::event evt;
+
+    cl_int err = clEnqueueWriteBuffer(write_on.native_command_queue.data, buf.native_mem_object.data, CL_TRUE, 0, bytes, ptr, evts.size(), evts.data(), &evt.native_event.data);
+
+    if(err != CL_SUCCESS)
+        throw std::runtime_error("Could not write managed buffer, with error " + std::to_string(err));
+
+    return evt;
+}
+
+void cl::managed_buffer::read(cl::command_queue& read_on, char* ptr, int64_t bytes)
+{
+    assert(bytes <= alloc_size());
+
+    std::optional<cl::buffer> buf;
+    cl::event last_use;
+
+    ///evicted buffers are read straight out of host memory, once the readback has landed. Retries if an exec made it resident again in the meantime
+    ///a readback which failed never reports CL_COMPLETE, so one that's been waited on already counts as landed
+    cl::event waited;
+
+    while(!buf.has_value())
+    {
+        cl::event evicting;
+
+        {
+            std::scoped_lock guard(pool->mut);
+
+            if(data->device.has_value())
+            {
+                buf = data->device;
+                last_use = data->last_use;
+                break;
+            }
+
+            if(data->evicting.native_event.data == waited.native_event.data || data->evicting.is_finished())
+            {
+                if(data->host.size() > 0)
+                    memcpy(ptr, data->host.data(), bytes);
+
+                return;
+            }
+
+            evicting = data->evicting;
+        }
+
+        evicting.block();
+        waited = evicting;
+    }
+
+    std::vector<cl_event> evts = to_raw_events({last_use});
 
-    return as_props(*this, flags, region);
+    cl_int err = clEnqueueReadBuffer(read_on.native_command_queue.data, buf->native_mem_object.data, CL_TRUE, 0, bytes, ptr, evts.size(), evts.data(), nullptr);
+
+    if(err != CL_SUCCESS)
+        throw std::runtime_error("Could not read managed buffer, with error " + std::to_string(err));
 }
 
 cl::image::image(cl::context& ctx)
 {
+    ctx.ensure_created();
+
     native_context = ctx.native_context;
 }
 
@@ -1138,6 +2583,8 @@ void cl::image::alloc_impl(int dims, const std::array<int64_t, 3>& _sizes, const
         throw std::runtime_error("Could not clCreateImage " + std::to_string(err));
     }
 
+    track_allocation(native_context.data, ret, memory_tag, true);
+
     dimensions = dims;
     sizes = _sizes;
     native_mem_object.consume(ret);
@@ -1173,6 +2620,154 @@ void cl::image_base::read_impl(cl::command_queue& cqueue, const vec<4, size_t>&
     }
 }
 
+namespace
+{
+cl_channel_type get_rgba_channel_type(cl_mem mem)
+{
+    cl_image_format format = {};
+
+    cl_int err = clGetImageInfo(mem, CL_IMAGE_FORMAT, sizeof(format), &format, nullptr);
+
+    if(err != CL_SUCCESS)
+        throw std::runtime_error("Could not query image format " + std::to_string(err));
+
+    if(format.image_channel_order != CL_RGBA)
+        throw std::runtime_error("Host side conversion requires a CL_RGBA image");
+
+    cl_channel_type type = format.image_channel_data_type;
+
+    if(type != CL_FLOAT && type != CL_HALF_FLOAT && type != CL_UNORM_INT8)
+        throw std::runtime_error("Host side conversion requires CL_FLOAT, CL_HALF_FLOAT or CL_UNORM_INT8 channels, got " + std::to_string(type));
+
+    return type;
+}
+
+int64_t image_pixels(const std::array<int64_t, 3>& sizes)
+{
+    return sizes[0] * sizes[1] * sizes[2];
+}
+}
+
+std::vector<float> cl::image_base::read_float4(cl::command_queue& cqueue)
+{
+    cl_channel_type type = get_rgba_channel_type(native_mem_object.data);
+
+    int64_t pixels = image_pixels(sizes);
+
+    vec<4, size_t> origin = {0,0,0,0};
+    vec<4, size_t> region = {(size_t)sizes[0], (size_t)sizes[1], (size_t)sizes[2], 1};
+
+    std::vector<float> ret(pixels * 4);
+
+    if(pixels == 0)
+        return ret;
+
+    if(type == CL_FLOAT)
+    {
+        read_impl(cqueue, origin, region, (char*)ret.data());
+    }
+    else if(type == CL_HALF_FLOAT)
+    {
+        std::vector<uint16_t> raw(pixels * 4);
+        read_impl(cqueue, origin, region, (char*)raw.data());
+
+        pixel::half_to_float(raw.data(), ret.data(), raw.size());
+    }
+    else
+    {
+        std::vector<uint8_t> raw(pixels * 4);
+        read_impl(cqueue, origin, region, (char*)raw.data());
+
+        pixel::rgba8_to_float4(raw.data(), ret.data(), pixels);
+    }
+
+    return ret;
+}
+
+std::vector<uint8_t> cl::image_base::read_rgba8(cl::command_queue& cqueue, bool srgb)
+{
+    cl_channel_type type = get_rgba_channel_type(native_mem_object.data);
+
+    int64_t pixels = image_pixels(sizes);
+
+    std::vector<uint8_t> ret(pixels * 4);
+
+    if(pixels == 0)
+        return ret;
+
+    if(type == CL_UNORM_INT8 && !srgb)
+    {
+        vec<4, size_t> origin = {0,0,0,0};
+        vec<4, size_t> region = {(size_t)sizes[0], (size_t)sizes[1], (size_t)sizes[2], 1};
+
+        read_impl(cqueue, origin, region, (char*)ret.data());
+
+        return ret;
+    }
+
+    std::vector<float> as_float = read_float4(cqueue);
+
+    pixel::float4_to_rgba8(as_float.data(), ret.data(), pixels, srgb);
+
+    return ret;
+}
+
+void cl::image::write_float4(command_queue& write_on, const float* rgba)
+{
+    cl_channel_type type = get_rgba_channel_type(native_mem_object.data);
+
+    int64_t pixels = image_pixels(sizes);
+
+    if(pixels == 0)
+        return;
+
+    vec<3, size_t> origin = {0,0,0};
+    vec<3, size_t> region = {(size_t)sizes[0], (size_t)sizes[1], (size_t)sizes[2]};
+
+    if(type == CL_FLOAT)
+    {
+        write_impl(write_on, (const char*)rgba, origin, region);
+    }
+    else if(type == CL_HALF_FLOAT)
+    {
+        std::vector<uint16_t> raw(pixels * 4);
+        pixel::float_to_half(rgba, raw.data(), raw.size());
+
+        write_impl(write_on, (const char*)raw.data(), origin, region);
+    }
+    else
+    {
+        std::vector<uint8_t> raw(pixels * 4);
+        pixel::float4_to_rgba8(rgba, raw.data(), pixels);
+
+        write_impl(write_on, (const char*)raw.data(), origin, region);
+    }
+}
+
+void cl::image::write_rgba8(command_queue& write_on, const uint8_t* rgba, bool srgb)
+{
+    cl_channel_type type = get_rgba_channel_type(native_mem_object.data);
+
+    int64_t pixels = image_pixels(sizes);
+
+    if(pixels == 0)
+        return;
+
+    if(type == CL_UNORM_INT8 && !srgb)
+    {
+        vec<3, size_t> origin = {0,0,0};
+        vec<3, size_t> region = {(size_t)sizes[0], (size_t)sizes[1], (size_t)sizes[2]};
+
+        write_impl(write_on, (const char*)rgba, origin, region);
+        return;
+    }
+
+    std::vector<float> as_float(pixels * 4);
+    pixel::rgba8_to_float4(rgba, as_float.data(), pixels, srgb);
+
+    write_float4(write_on, as_float.data());
+}
+
 void cl::image::write_impl(command_queue& write_on, const char* ptr, const vec<3, size_t>& origin, const vec<3, size_t>& region)
 {
     cl_int err = clEnqueueWriteImage(write_on.native_command_queue.data, native_mem_object.data, true, &origin.v[0], &region.v[0], 0, 0, ptr, 0, nullptr, nullptr);
@@ -1186,6 +2781,8 @@ void cl::image::write_impl(command_queue& write_on, const char* ptr, const vec<3
 
 cl::image_with_mipmaps::image_with_mipmaps(cl::context& ctx)
 {
+    ctx.ensure_created();
+
     native_context = ctx.native_context;
 }
 
@@ -1230,6 +2827,8 @@ void cl::image_with_mipmaps::alloc_impl(int dims, const std::array<int64_t, 3>&
         throw std::runtime_error("Could not clCreateImage");
     }
 
+    track_allocation(native_context.data, ret, memory_tag, true);
+
     dimensions = dims;
     sizes = _sizes;
     native_mem_object.consume(ret);
@@ -1251,6 +2850,8 @@ void cl::image_with_mipmaps::write_impl(command_queue& write_on, const char* ptr
 
 cl::command_queue::command_queue(cl::context& ctx, cl_command_queue_properties props) : shared(ctx.shared)
 {
+    ctx.ensure_created();
+
     cl_int err;
 
     #ifndef GPU_PROFILE
@@ -1275,14 +2876,31 @@ cl::command_queue::command_queue()
 
 }
 
-cl::device_command_queue::device_command_queue(cl::context& ctx, cl_command_queue_properties props)
+void cl::command_queue::enable_transfer_queue(cl::context& ctx)
 {
+    if(transfer)
+        return;
+
+    transfer = std::make_shared<transfer_route>(ctx);
+}
+
+cl::device_command_queue::device_command_queue(cl::context& ctx, cl_command_queue_properties props, cl_uint requested_size)
+{
+    const device_caps& caps = ctx.get_caps();
+
+    if(!caps.is_at_least(2, 0) || caps.queue_on_device_max_size == 0)
+        throw std::runtime_error("Device " + caps.name + " does not support device side enqueue");
+
     cl_int err;
 
     shared = ctx.shared;
 
-    cl_queue_properties qprop[] = { CL_QUEUE_SIZE, 4096, CL_QUEUE_PROPERTIES,
-     (cl_command_queue_properties)(CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE |
+    queue_size = requested_size != 0 ? requested_size : caps.queue_on_device_preferred_size;
+    queue_size = std::clamp<cl_uint>(queue_size, 1, caps.queue_on_device_max_size);
+
+    cl_queue_properties qprop[] = { CL_QUEUE_SIZE, queue_size, CL_QUEUE_PROPERTIES,
+     (cl_command_queue_properties)(props |
+                                   CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE |
                                    CL_QUEUE_ON_DEVICE |
                                    CL_QUEUE_ON_DEVICE_DEFAULT), 0 };
 
@@ -1309,20 +2927,26 @@ cl::event cl::command_queue::enqueue_marker(const std::vector<cl::event>& deps)
     return ret;
 }
 
-cl::event cl::command_queue::exec(cl::kernel& kern, const std::vector<size_t>& global_ws, const std::vector<size_t>& local_ws, const std::vector<event>& deps)
+cl::event cl::command_queue::exec(cl::kernel& kern, const std::vector<size_t>& global_ws, const std::vector<size_t>& local_ws, const std::vector<event>& deps, const std::vector<size_t>& global_offset)
 {
     cl::event ret;
 
     int dim = global_ws.size();
 
+    assert(global_offset.size() == 0 || (int)global_offset.size() == dim);
+
     size_t g_ws[3] = {0};
     size_t l_ws[3] = {0};
+    size_t g_off[3] = {0};
 
     for(int i=0; i < dim; i++)
     {
         l_ws[i] = local_ws[i];
         g_ws[i] = global_ws[i];
 
+        if(global_offset.size() > 0)
+            g_off[i] = global_offset[i];
+
         if(l_ws[i] == 0)
             continue;
 
@@ -1345,10 +2969,10 @@ cl::event cl::command_queue::exec(cl::kernel& kern, const std::vector<size_t>& g
     cl_int err = CL_SUCCESS;
 
     #ifndef GPU_PROFILE
-    err = clEnqueueNDRangeKernel(native_command_queue.data, kern.native_kernel.data, dim, nullptr, g_ws, l_ws, events.size(), events.data(), &ret.native_event.data);
+    err = clEnqueueNDRangeKernel(native_command_queue.data, kern.native_kernel.data, dim, global_offset.size() > 0 ? g_off : nullptr, g_ws, l_ws, events.size(), events.data(), &ret.native_event.data);
     #else
 
-    err = clEnqueueNDRangeKernel(native_command_queue.data, kern.native_kernel.data, dim, nullptr, g_ws, l_ws, events.size(), events.data(), &ret.native_event.data);
+    err = clEnqueueNDRangeKernel(native_command_queue.data, kern.native_kernel.data, dim, global_offset.size() > 0 ? g_off : nullptr, g_ws, l_ws, events.size(), events.data(), &ret.native_event.data);
 
     cl_ulong start;
     cl_ulong finish;
@@ -1379,112 +3003,333 @@ bool cl::shared_kernel_info::promote_pending(const std::string& name)
     std::shared_ptr<pending_kernel> pend;
 
     {
-        std::scoped_lock lock(mut);
-        bool found = false;
+        std::scoped_lock lock(mut);
+        bool found = false;
+
+        for(auto& [check_name, ptr] : pending_kernels)
+        {
+            if(check_name == name)
+            {
+                pend = ptr;
+                found = true;
+            }
+        }
+
+        if(!found)
+            return false;
+    }
+
+    pend->latch.wait();
+
+    {
+        std::scoped_lock lock(mut);
+
+        bool should_add = false;
+
+        ///someone might have done the same thing in the meantime, remove us from pending_kernels but don't be too surprised if its not found
+
+        for(auto it = pending_kernels.begin(); it != pending_kernels.end();)
+        {
+            if(it->second == pend)
+            {
+                ///only add us to the kernels list if we were the one that removed us from pending kernels
+                should_add = true;
+                break;
+            }
+            else
+                it++;
+        }
+
+        ///race condition in that someone did this first, but still a valid sign for the caller to re-check
+        if(!should_add)
+            return true;
+
+        std::map<std::string, kernel, std::less<>>& next = kernels.emplace_back();
+        next[name] = pend->kernel.value();
+    }
+
+    return true;
+}
+
+cl::event cl::command_queue::exec(const std::string& kname, cl::args& pack, const std::vector<size_t>& global_ws, const std::vector<size_t>& local_ws, const std::vector<event>& deps, const std::vector<size_t>& global_offset)
+{
+    assert(global_ws.size() == local_ws.size());
+
+    {
+        std::vector<std::map<std::string, kernel, std::less<>>> current;
+
+        {
+            std::scoped_lock lock(shared->mut);
+
+            current = shared->kernels;
+        }
+
+        for(auto& kerns : current)
+        {
+            auto kernel_it = kerns.find(kname);
+
+            if(kernel_it == kerns.end())
+                continue;
+
+            cl::kernel& kern = kernel_it->second;
+
+            std::vector<event> residency_deps;
+            uint64_t exec_id = next_exec_id++;
+
+            for(auto& arg : pack.arg_list)
+                arg->prepare(*this, residency_deps, exec_id);
+
+            kern.set_args(pack);
+
+            event ret;
+
+            if(residency_deps.size() == 0)
+                ret = exec(kern, global_ws, local_ws, deps, global_offset);
+            else
+            {
+                residency_deps.insert(residency_deps.end(), deps.begin(), deps.end());
+
+                ret = exec(kern, global_ws, local_ws, residency_deps, global_offset);
+            }
+
+            for(auto& arg : pack.arg_list)
+                arg->used(ret);
+
+            return ret;
+        }
+    }
+
+    if(shared->promote_pending(kname))
+    {
+        return exec(kname, pack, global_ws, local_ws, deps, global_offset);
+    }
+
+    throw std::runtime_error("Kernel " + kname + " not found in any program");
+}
+
+cl::event cl::command_queue::exec(const std::string& kname, cl::args& pack, const std::vector<size_t>& global_ws, const std::vector<size_t>& local_ws)
+{
+    std::vector<cl::event> evts;
+
+    return exec(kname, pack, global_ws, local_ws, evts);
+}
+
+cl::event cl::command_queue::exec_chunked(const std::string& kname, cl::args& pack, const std::vector<size_t>& global_ws, const std::vector<size_t>& local_ws, size_t max_items_per_chunk,
+                                          const std::vector<event>& deps, const chunk_callback& on_chunk)
+{
+    assert(global_ws.size() == local_ws.size());
+    assert(global_ws.size() > 0);
+
+    int split = global_ws.size() - 1;
+
+    size_t items_per_slice = 1;
+
+    for(int i=0; i < split; i++)
+    {
+        size_t extent = global_ws[i];
+
+        if(local_ws[i] != 0)
+            extent = ((extent + local_ws[i] - 1) / local_ws[i]) * local_ws[i];
+
+        items_per_slice *= std::max(extent, (size_t)1);
+    }
+
+    size_t total = global_ws[split];
+    size_t local = std::max(local_ws[split], (size_t)1);
+
+    size_t chunk = std::max(max_items_per_chunk / items_per_slice, (size_t)1);
+    ///a partial work group per chunk would get rounded up by exec, and overlap the next chunk
+    chunk = std::max((chunk / local) * local, local);
+
+    if(chunk >= total)
+        return exec(kname, pack, global_ws, local_ws, deps);
+
+    std::vector<event> chunk_events;
+    std::vector<size_t> chunk_global = global_ws;
+    std::vector<size_t> chunk_offset(global_ws.size(), 0);
+
+    for(size_t start = 0; start < total; start += chunk)
+    {
+        chunk_global[split] = std::min(chunk, total - start);
+        chunk_offset[split] = start;
+
+        event evt = exec(kname, pack, chunk_global, local_ws, deps, chunk_offset);
+
+        ///hands the slice to the device now, rather than whenever the driver gets round to it
+        clFlush(native_command_queue.data);
+
+        chunk_events.push_back(evt);
+
+        if(on_chunk)
+            on_chunk(evt, start + chunk_global[split], total);
+    }
+
+    return enqueue_marker(chunk_events);
+}
+
+void cl::command_queue::block()
+{
+    clFinish(native_command_queue.data);
+
+    if(transfer)
+        clFinish(transfer->queue.native_command_queue.data);
+}
+
+void cl::command_queue::flush()
+{
+    clFlush(native_command_queue.data);
+
+    if(transfer)
+        clFlush(transfer->queue.native_command_queue.data);
+}
+
+namespace
+{
+    int64_t transfer_bytes_per_pixel(cl::gl_transfer_format::type fmt)
+    {
+        if(fmt == cl::gl_transfer_format::HALF_FLOAT)
+            return sizeof(cl_half) * 4;
+
+        if(fmt == cl::gl_transfer_format::UNORM8)
+            return sizeof(cl_uchar) * 4;
+
+        return sizeof(cl_float) * 4;
+    }
+
+    cl_channel_type transfer_cl_type(cl::gl_transfer_format::type fmt)
+    {
+        if(fmt == cl::gl_transfer_format::HALF_FLOAT)
+            return CL_HALF_FLOAT;
+
+        if(fmt == cl::gl_transfer_format::UNORM8)
+            return CL_UNORM_INT8;
+
+        return CL_FLOAT;
+    }
+
+    GLenum transfer_gl_type(cl::gl_transfer_format::type fmt)
+    {
+        if(fmt == cl::gl_transfer_format::HALF_FLOAT)
+            return GL_HALF_FLOAT;
+
+        if(fmt == cl::gl_transfer_format::UNORM8)
+            return GL_UNSIGNED_BYTE;
+
+        return GL_FLOAT;
+    }
+
+    void wait_for_fence(GLsync& fence)
+    {
+        if(fence == nullptr)
+            return;
 
-        for(auto& [check_name, ptr] : pending_kernels)
+        GLenum result = GL_TIMEOUT_EXPIRED;
+
+        while(result == GL_TIMEOUT_EXPIRED)
         {
-            if(check_name == name)
-            {
-                pend = ptr;
-                found = true;
-            }
+            result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000 * 1000);
         }
 
-        if(!found)
-            return false;
+        glDeleteSync(fence);
+        fence = nullptr;
     }
+}
 
-    pend->latch.wait();
+cl::gl_unpack_ring::gl_unpack_ring(int count, int64_t _bytes) : bytes(_bytes)
+{
+    assert(count > 0);
+    assert(bytes > 0);
 
-    {
-        std::scoped_lock lock(mut);
+    slots.resize(count);
 
-        bool should_add = false;
+    ///persistent mapping lets cl write straight into memory that gl can source from without a map/unmap each frame
+    persistent = GLEW_ARB_buffer_storage;
 
-        ///someone might have done the same thing in the meantime, remove us from pending_kernels but don't be too surprised if its not found
+    for(slot& s : slots)
+    {
+        glGenBuffers(1, &s.pbo);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.pbo);
 
-        for(auto it = pending_kernels.begin(); it != pending_kernels.end();)
+        if(persistent)
         {
-            if(it->second == pend)
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+            glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, flags);
+            s.mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, flags);
+
+            if(s.mapped == nullptr)
             {
-                ///only add us to the kernels list if we were the one that removed us from pending kernels
-                should_add = true;
-                break;
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                throw std::runtime_error("Could not persistently map pixel unpack buffer");
             }
-            else
-                it++;
         }
-
-        ///race condition in that someone did this first, but still a valid sign for the caller to re-check
-        if(!should_add)
-            return true;
-
-        std::map<std::string, kernel, std::less<>>& next = kernels.emplace_back();
-        next[name] = pend->kernel.value();
+        else
+        {
+            glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        }
     }
 
-    return true;
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 }
 
-cl::event cl::command_queue::exec(const std::string& kname, cl::args& pack, const std::vector<size_t>& global_ws, const std::vector<size_t>& local_ws, const std::vector<event>& deps)
+cl::gl_unpack_ring::~gl_unpack_ring()
 {
-    assert(global_ws.size() == local_ws.size());
-
+    for(slot& s : slots)
     {
-        std::vector<std::map<std::string, kernel, std::less<>>> current;
+        ///cl may still be writing into the mapped pointer
+        s.read_event.block();
 
+        if(s.fence)
         {
-            std::scoped_lock lock(shared->mut);
-
-            current = shared->kernels;
+            glDeleteSync(s.fence);
+            s.fence = nullptr;
         }
 
-        for(auto& kerns : current)
+        if(s.mapped)
         {
-            auto kernel_it = kerns.find(kname);
-
-            if(kernel_it == kerns.end())
-                continue;
-
-            cl::kernel& kern = kernel_it->second;
-
-            kern.set_args(pack);
-
-            return exec(kern, global_ws, local_ws, deps);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, s.pbo);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            s.mapped = nullptr;
         }
-    }
 
-    if(shared->promote_pending(kname))
-    {
-        return exec(kname, pack, global_ws, local_ws, deps);
+        glDeleteBuffers(1, &s.pbo);
+        s.pbo = 0;
     }
 
-    throw std::runtime_error("Kernel " + kname + " not found in any program");
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
 }
 
-cl::event cl::command_queue::exec(const std::string& kname, cl::args& pack, const std::vector<size_t>& global_ws, const std::vector<size_t>& local_ws)
+cl::gl_rendertexture::gl_rendertexture(context& ctx)
 {
-    std::vector<cl::event> evts;
+    ctx.ensure_created();
 
-    return exec(kname, pack, global_ws, local_ws, evts);
-}
+    native_context = ctx.native_context;
 
-void cl::command_queue::block()
-{
-    clFinish(native_command_queue.data);
+    sharing_is_available = cl::supports_extension(ctx, "cl_khr_gl_sharing");
 }
 
-void cl::command_queue::flush()
+void cl::gl_rendertexture::set_fallback_transfer(gl_transfer_format::type format, int buffers, bool about_to_recreate)
 {
-    clFlush(native_command_queue.data);
-}
+    assert(buffers >= 0);
 
-cl::gl_rendertexture::gl_rendertexture(context& ctx)
-{
-    native_context = ctx.native_context;
+    bool format_changed = format != transfer_format;
 
-    sharing_is_available = cl::supports_extension(ctx, "cl_khr_gl_sharing");
+    transfer_format = format;
+
+    ///a single buffer would have to be uploaded and refilled within the same frame, which is just the blocking path
+    if(buffers == 1)
+        buffers = 2;
+
+    fallback_buffers = buffers;
+    unpack_ring = nullptr;
+
+    if(sharing_is_available || native_mem_object.data == nullptr || !format_changed || about_to_recreate)
+        return;
+
+    if(acquired)
+        throw std::runtime_error("Cannot change the fallback transfer of a gl_rendertexture while it is acquired");
+
+    create_fallback_image();
 }
 
 void cl::gl_rendertexture::create(int _w, int _h)
@@ -1520,6 +3365,42 @@ void cl::gl_rendertexture::create(int _w, int _h)
     native_mem_object.consume(cmem);
 }
 
+void cl::gl_rendertexture::create_fallback_image()
+{
+    native_mem_object.release();
+
+    cl_image_format format;
+    format.image_channel_order = CL_RGBA;
+    format.image_channel_data_type = transfer_cl_type(transfer_format);
+
+    cl_image_desc desc = {};
+    desc.image_type = CL_MEM_OBJECT_IMAGE2D;
+    desc.image_width = sizes[0];
+    desc.image_height = sizes[1];
+    desc.image_depth = sizes[2];
+    desc.image_array_size = 1;
+    desc.image_row_pitch = 0;
+    desc.image_slice_pitch = 0;
+    desc.num_mip_levels = 0;
+    desc.num_samples = 0;
+    desc.buffer = nullptr;
+
+    cl_int err;
+    cl_mem cmem = clCreateImage(native_context.data, CL_MEM_READ_WRITE, &format, &desc, nullptr, &err);
+
+    if(err != CL_SUCCESS)
+    {
+        std::cout << "Failure in create from rendertexture " << err << std::endl;
+        throw std::runtime_error("Failure in create_from rendertexture");
+    }
+
+    track_allocation(native_context.data, cmem, memory_tag, true);
+
+    native_mem_object.consume(cmem);
+
+    unpack_ring = nullptr;
+}
+
 void cl::gl_rendertexture::create_from_texture(GLuint _texture_id)
 {
     ///Do I need this?
@@ -1556,32 +3437,7 @@ void cl::gl_rendertexture::create_from_texture(GLuint _texture_id)
     }
     else
     {
-        cl_image_format format;
-        format.image_channel_order = CL_RGBA;
-        format.image_channel_data_type = CL_FLOAT;
-
-        cl_image_desc desc = {};
-        desc.image_type = CL_MEM_OBJECT_IMAGE2D;
-        desc.image_width = w;
-        desc.image_height = h;
-        desc.image_depth = d;
-        desc.image_array_size = 1;
-        desc.image_row_pitch = 0;
-        desc.image_slice_pitch = 0;
-        desc.num_mip_levels = 0;
-        desc.num_samples = 0;
-        desc.buffer = nullptr;
-
-        cl_int err;
-        cl_mem cmem = clCreateImage(native_context.data, CL_MEM_READ_WRITE, &format, &desc, nullptr, &err);
-
-        if(err != CL_SUCCESS)
-        {
-            std::cout << "Failure in create from rendertexture " << err << std::endl;
-            throw std::runtime_error("Failure in create_from rendertexture");
-        }
-
-        native_mem_object.consume(cmem);
+        create_fallback_image();
     }
 
     texture_id = _texture_id;
@@ -1689,18 +3545,86 @@ cl::event cl::gl_rendertexture::unacquire(cl::command_queue& cqueue, const std::
     {
         clEnqueueReleaseGLObjects(cqueue.native_command_queue.data, 1, &native_mem_object.data, events.size(), events.data(), &ret.native_event.data);
     }
-    else
+    else if(fallback_buffers == 0)
     {
-        std::vector<cl_event> raw_events = to_raw_events(deps);
+        wait_all(deps);
 
-        if(raw_events.size() > 0)
-            clWaitForEvents(raw_events.size(), raw_events.data());
+        std::vector<char> data;
+        data.resize(sizes[0] * sizes[1] * transfer_bytes_per_pixel(transfer_format));
 
-        std::vector<cl_float4> data = this->read<2, cl_float4>(cqueue, {0,0}, {sizes[0], sizes[1]});
+        read_impl(cqueue, {0,0,0,0}, {(size_t)sizes[0], (size_t)sizes[1], 1, 1}, data.data());
 
         glBindTexture(GL_TEXTURE_2D, texture_id);
 
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, sizes[0], sizes[1], GL_RGBA, GL_FLOAT, (void*)data.data());
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, sizes[0], sizes[1], GL_RGBA, transfer_gl_type(transfer_format), (void*)data.data());
+    }
+    else
+    {
+        int64_t bytes = sizes[0] * sizes[1] * transfer_bytes_per_pixel(transfer_format);
+
+        if(unpack_ring == nullptr || unpack_ring->bytes != bytes || (int)unpack_ring->slots.size() != fallback_buffers)
+        {
+            unpack_ring = nullptr;
+            unpack_ring = std::make_shared<gl_unpack_ring>(fallback_buffers, bytes);
+        }
+
+        gl_unpack_ring& ring = *unpack_ring;
+
+        int count = ring.slots.size();
+
+        gl_unpack_ring::slot& write_slot = ring.slots[ring.next];
+        gl_unpack_ring::slot& upload_slot = ring.slots[(ring.next + count - 1) % count];
+
+        ///gl must be finished sourcing from this buffer before cl overwrites it. With 2+ buffers this was issued frames ago
+        wait_for_fence(write_slot.fence);
+
+        if(!ring.persistent)
+        {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, write_slot.pbo);
+            write_slot.mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+            if(write_slot.mapped == nullptr)
+                throw std::runtime_error("Could not map pixel unpack buffer");
+        }
+
+        size_t origin[3] = {0, 0, 0};
+        size_t region[3] = {(size_t)sizes[0], (size_t)sizes[1], 1};
+
+        write_slot.read_event = cl::event();
+
+        CHECK(clEnqueueReadImage(cqueue.native_command_queue.data, native_mem_object.data, CL_FALSE, origin, region, 0, 0, write_slot.mapped, events.size(), events.data(), &write_slot.read_event.native_event.data));
+
+        write_slot.pending = true;
+        ret = write_slot.read_event;
+
+        cqueue.flush();
+
+        ///upload last frame's readback, which has had a whole frame to complete
+        if(upload_slot.pending)
+        {
+            upload_slot.read_event.block();
+
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload_slot.pbo);
+
+            if(!ring.persistent)
+            {
+                glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                upload_slot.mapped = nullptr;
+            }
+
+            glBindTexture(GL_TEXTURE_2D, texture_id);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, sizes[0], sizes[1], GL_RGBA, transfer_gl_type(transfer_format), nullptr);
+
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+            if(ring.persistent)
+                upload_slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+            upload_slot.pending = false;
+        }
+
+        ring.next = (ring.next + 1) % count;
     }
 
     return ret;
@@ -1711,79 +3635,270 @@ cl::event cl::gl_rendertexture::unacquire(cl::command_queue& cqueue)
     return unacquire(cqueue, {});
 }
 
+void cl::wait_for_ring_slot(std::vector<cl::event>& in_flight, cl::ring_stats& stats)
+{
+    stats.acquires++;
+
+    bool all_finished = true;
+
+    for(cl::event& e : in_flight)
+    {
+        if(!e.is_finished())
+        {
+            all_finished = false;
+            break;
+        }
+    }
+
+    if(!all_finished)
+    {
+        steady_timer clk;
+
+        wait_all(in_flight);
+
+        double elapsed = clk.get_elapsed_time_s();
+
+        stats.stalls++;
+        stats.stall_time_s += elapsed;
+        stats.max_stall_s = std::max(stats.max_stall_s, elapsed);
+    }
+
+    in_flight.clear();
+}
+
 cl::event cl::copy(cl::command_queue& cqueue, cl::buffer& source, cl::buffer& dest, const std::vector<cl::event>& events)
+{
+    assert(source.alloc_size == dest.alloc_size);
+
+    return copy(cqueue, source, 0, dest, 0, std::min(source.alloc_size, dest.alloc_size), events);
+}
+
+cl::event cl::copy(cl::command_queue& cqueue, cl::buffer& source, int64_t source_offset, cl::buffer& dest, int64_t dest_offset, int64_t bytes, const std::vector<cl::event>& events)
 {
     cl::event evt;
 
-    assert(source.alloc_size == dest.alloc_size);
+    assert(source_offset >= 0 && dest_offset >= 0 && bytes >= 0);
+    assert(source_offset + bytes <= source.alloc_size);
+    assert(dest_offset + bytes <= dest.alloc_size);
+
+    if(bytes == 0)
+        return evt;
+
+    std::vector<cl::event> deps = events;
+    cl::command_queue& queue = begin_transfer(cqueue, {source.native_mem_object.data, dest.native_mem_object.data}, deps);
+    std::vector<cl_event> raw_events = to_raw_events(deps);
+
+    cl_int err = clEnqueueCopyBuffer(queue.native_command_queue.data, source.native_mem_object.data, dest.native_mem_object.data, source_offset, dest_offset, bytes, raw_events.size(), raw_events.data(), &evt.native_event.data);
+
+    if(err != CL_SUCCESS)
+    {
+        throw std::runtime_error("Could not copy buffers, " + std::to_string(bytes) + " bytes from offset " + std::to_string(source_offset) + " to " + std::to_string(dest_offset) + ", error " + std::to_string(err));
+    }
+
+    end_transfer(cqueue, {source.native_mem_object.data, dest.native_mem_object.data}, evt);
+
+    return evt;
+}
 
-    size_t amount = std::min(source.alloc_size, dest.alloc_size);
+cl::event cl::copy_rect(cl::command_queue& cqueue, cl::buffer& source, vec3i source_origin, cl::buffer& dest, vec3i dest_origin, vec3i region,
+                        size_t source_row_pitch, size_t source_slice_pitch, size_t dest_row_pitch, size_t dest_slice_pitch, const std::vector<cl::event>& events)
+{
+    cl::event evt;
 
-    if(amount == 0)
+    if(region.x() <= 0 || region.y() <= 0 || region.z() <= 0)
         return evt;
 
-    std::vector<cl_event> raw_events = to_raw_events(events);
+    size_t src_origin[3] = {(size_t)source_origin.x(), (size_t)source_origin.y(), (size_t)source_origin.z()};
+    size_t dst_origin[3] = {(size_t)dest_origin.x(), (size_t)dest_origin.y(), (size_t)dest_origin.z()};
+    size_t iregion[3] = {(size_t)region.x(), (size_t)region.y(), (size_t)region.z()};
 
-    cl_int err = clEnqueueCopyBuffer(cqueue.native_command_queue.data, source.native_mem_object.data, dest.native_mem_object.data, 0, 0, amount, raw_events.size(), raw_events.data(), &evt.native_event.data);
+    std::vector<cl::event> deps = events;
+    cl::command_queue& queue = begin_transfer(cqueue, {source.native_mem_object.data, dest.native_mem_object.data}, deps);
+    std::vector<cl_event> raw_events = to_raw_events(deps);
+
+    cl_int err = clEnqueueCopyBufferRect(queue.native_command_queue.data, source.native_mem_object.data, dest.native_mem_object.data, src_origin, dst_origin, iregion,
+                                         source_row_pitch, source_slice_pitch, dest_row_pitch, dest_slice_pitch, raw_events.size(), raw_events.data(), &evt.native_event.data);
 
     if(err != CL_SUCCESS)
     {
-        throw std::runtime_error("Could not copy buffers");
+        throw std::runtime_error("Could not copy buffer rect, error " + std::to_string(err));
     }
 
+    end_transfer(cqueue, {source.native_mem_object.data, dest.native_mem_object.data}, evt);
+
     return evt;
 }
 
-std::string cl::get_extensions(context& ctx)
+cl::event cl::copy_buffer_to_image(cl::command_queue& cqueue, cl::buffer& source, int64_t source_offset, cl::mem_object& image, vec3i origin, vec3i region, const std::vector<cl::event>& events)
 {
-    size_t arr_size = 0;
-    cl_int err = clGetDeviceInfo(ctx.selected_device, CL_DEVICE_EXTENSIONS, 0, nullptr, &arr_size);
+    cl::event evt;
+
+    if(region.x() <= 0 || region.y() <= 0 || region.z() <= 0)
+        return evt;
+
+    size_t iorigin[3] = {(size_t)origin.x(), (size_t)origin.y(), (size_t)origin.z()};
+    size_t iregion[3] = {(size_t)region.x(), (size_t)region.y(), (size_t)region.z()};
+
+    std::vector<cl_event> raw_events = ordered_on_compute(cqueue, {source.native_mem_object.data, image.native_mem_object.data}, events);
+
+    cl_int err = clEnqueueCopyBufferToImage(cqueue.native_command_queue.data, source.native_mem_object.data, image.native_mem_object.data, source_offset, iorigin, iregion, raw_events.size(), raw_events.data(), &evt.native_event.data);
 
     if(err != CL_SUCCESS)
     {
-        throw std::runtime_error("Error in clGetDeviceInfo");
+        throw std::runtime_error("Could not copy buffer to image, error " + std::to_string(err));
     }
 
-    if(arr_size == 0)
-        return "";
+    record_on_compute(cqueue, {source.native_mem_object.data, image.native_mem_object.data}, evt);
+
+    return evt;
+}
+
+cl::event cl::copy_image_to_buffer(cl::command_queue& cqueue, cl::mem_object& image, vec3i origin, vec3i region, cl::buffer& dest, int64_t dest_offset, const std::vector<cl::event>& events)
+{
+    cl::event evt;
+
+    if(region.x() <= 0 || region.y() <= 0 || region.z() <= 0)
+        return evt;
+
+    size_t iorigin[3] = {(size_t)origin.x(), (size_t)origin.y(), (size_t)origin.z()};
+    size_t iregion[3] = {(size_t)region.x(), (size_t)region.y(), (size_t)region.z()};
+
+    std::vector<cl_event> raw_events = ordered_on_compute(cqueue, {image.native_mem_object.data, dest.native_mem_object.data}, events);
+
+    cl_int err = clEnqueueCopyImageToBuffer(cqueue.native_command_queue.data, image.native_mem_object.data, dest.native_mem_object.data, iorigin, iregion, dest_offset, raw_events.size(), raw_events.data(), &evt.native_event.data);
+
+    if(err != CL_SUCCESS)
+    {
+        throw std::runtime_error("Could not copy image to buffer, error " + std::to_string(err));
+    }
 
-    std::string extensions;
-    extensions.resize(arr_size + 1);
+    record_on_compute(cqueue, {image.native_mem_object.data, dest.native_mem_object.data}, evt);
 
-    err = clGetDeviceInfo(ctx.selected_device, CL_DEVICE_EXTENSIONS, arr_size, extensions.data(), nullptr);
+    return evt;
+}
 
-    return extensions;
+std::string cl::get_extensions(context& ctx)
+{
+    return ctx.get_caps().extensions_string;
 }
 
 bool cl::supports_extension(cl_device_id device_id, const std::string& name)
 {
-    size_t arr_size = 0;
-    cl_int err = clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, 0, nullptr, &arr_size);
+    return get_device_caps(device_id)->has_extension(name);
+}
 
-    if(err != CL_SUCCESS)
+bool cl::supports_extension(cl::context& ctx, const std::string& name)
+{
+    return ctx.get_caps().has_extension(name);
+}
+
+namespace
+{
+    std::string get_device_string(cl_device_id id, cl_device_info param)
     {
-        throw std::runtime_error("Error in clGetDeviceInfo");
+        std::vector<char> value = cl::get_device_info(id, param);
+
+        ///the returned size includes the null terminator
+        while(value.size() > 0 && value.back() == '\0')
+            value.pop_back();
+
+        return std::string(value.begin(), value.end());
     }
 
-    if(arr_size == 0)
-        return false;
+    ///zero rather than throwing for queries the device's version predates
+    template<typename T>
+    T get_device_info_or_zero(cl_device_id id, cl_device_info param)
+    {
+        T ret = T();
 
-    std::string extensions;
-    extensions.resize(arr_size + 1);
+        if(clGetDeviceInfo(id, param, sizeof(T), &ret, nullptr) != CL_SUCCESS)
+            return T();
 
-    err = clGetDeviceInfo(device_id, CL_DEVICE_EXTENSIONS, arr_size, &extensions[0], nullptr);
+        return ret;
+    }
+}
 
-    if(err != CL_SUCCESS)
+cl::device_caps::device_caps(cl_device_id id)
+{
+    name = get_device_string(id, CL_DEVICE_NAME);
+    vendor = get_device_string(id, CL_DEVICE_VENDOR);
+    version = get_device_string(id, CL_DEVICE_VERSION);
+    driver_version = get_device_string(id, CL_DRIVER_VERSION);
+
+    ///"OpenCL <major>.<minor> <vendor-specific information>"
+    if(sscanf(version.c_str(), "OpenCL %d.%d", &version_major, &version_minor) != 2)
+    {
+        version_major = 1;
+        version_minor = 0;
+    }
+
+    extensions_string = get_device_string(id, CL_DEVICE_EXTENSIONS);
+
+    size_t start = 0;
+
+    while(start < extensions_string.size())
+    {
+        size_t end = extensions_string.find(' ', start);
+
+        if(end == std::string::npos)
+            end = extensions_string.size();
+
+        if(end > start)
+            extensions.emplace(extensions_string.substr(start, end - start));
+
+        start = end + 1;
+    }
+
+    compute_units = get_device_info<cl_uint>(id, CL_DEVICE_MAX_COMPUTE_UNITS);
+    max_work_group_size = get_device_info<size_t>(id, CL_DEVICE_MAX_WORK_GROUP_SIZE);
+
+    cl_uint dimensions = get_device_info<cl_uint>(id, CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS);
+    max_work_item_sizes.resize(dimensions);
+
+    CHECK(clGetDeviceInfo(id, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(size_t) * dimensions, max_work_item_sizes.data(), nullptr));
+
+    global_mem_size = get_device_info<cl_ulong>(id, CL_DEVICE_GLOBAL_MEM_SIZE);
+    local_mem_size = get_device_info<cl_ulong>(id, CL_DEVICE_LOCAL_MEM_SIZE);
+    max_mem_alloc_size = get_device_info<cl_ulong>(id, CL_DEVICE_MAX_MEM_ALLOC_SIZE);
+    max_constant_buffer_size = get_device_info<cl_ulong>(id, CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE);
+    mem_base_addr_align = std::max<int64_t>(get_device_info<cl_uint>(id, CL_DEVICE_MEM_BASE_ADDR_ALIGN) / 8, 1);
+
+    image_support = get_device_info<cl_bool>(id, CL_DEVICE_IMAGE_SUPPORT);
+
+    if(image_support)
     {
-        throw std::runtime_error("Error in clGetDeviceInfo");
+        image2d_max_width = get_device_info<size_t>(id, CL_DEVICE_IMAGE2D_MAX_WIDTH);
+        image2d_max_height = get_device_info<size_t>(id, CL_DEVICE_IMAGE2D_MAX_HEIGHT);
+        image3d_max_width = get_device_info<size_t>(id, CL_DEVICE_IMAGE3D_MAX_WIDTH);
+        image3d_max_height = get_device_info<size_t>(id, CL_DEVICE_IMAGE3D_MAX_HEIGHT);
+        image3d_max_depth = get_device_info<size_t>(id, CL_DEVICE_IMAGE3D_MAX_DEPTH);
     }
 
-    return extensions.find(name) != std::string::npos;
+    if(is_at_least(2, 0))
+    {
+        queue_on_device_preferred_size = get_device_info_or_zero<cl_uint>(id, CL_DEVICE_QUEUE_ON_DEVICE_PREFERRED_SIZE);
+        queue_on_device_max_size = get_device_info_or_zero<cl_uint>(id, CL_DEVICE_QUEUE_ON_DEVICE_MAX_SIZE);
+    }
 }
 
-bool cl::supports_extension(cl::context& ctx, const std::string& name)
+std::shared_ptr<const cl::device_caps> cl::get_device_caps(cl_device_id id)
 {
-   return supports_extension(ctx.selected_device, name);
+    static std::mutex mut;
+    static std::map<cl_device_id, std::shared_ptr<const device_caps>> cache;
+
+    {
+        std::scoped_lock guard(mut);
+
+        if(auto it = cache.find(id); it != cache.end())
+            return it->second;
+    }
+
+    ///queried outside the lock, a racing thread just does the work twice
+    auto caps = std::make_shared<const device_caps>(id);
+
+    std::scoped_lock guard(mut);
+
+    return cache.try_emplace(id, caps).first->second;
 }
 
 std::vector<char> cl::get_device_info(cl_device_id id, cl_device_info param)
@@ -15,9 +15,12 @@
 #include <string_view>
 #include <atomic>
 #include <optional>
+#include <unordered_set>
 #include <functional>
 #include <span>
 #include <latch>
+#include <string.h>
+#include <mutex>
 
 #ifndef __clang__
 #include <stdfloat>
@@ -223,6 +226,8 @@ namespace cl
 
     struct command_queue;
     struct mem_object;
+    struct memory_tracker;
+    struct managed_pool;
 
     namespace mem_object_access
     {
@@ -235,9 +240,15 @@ namespace cl
         };
     }
 
+    ///returns a pointer which is valid for the rest of the program, for building mem_object::memory_tag at runtime
+    const char* intern_memory_tag(std::string_view tag);
+
     struct mem_object
     {
         shared_mem_object native_mem_object;
+        ///allocations are accounted against this tag in the owning context's memory_tracker. Set before alloc
+        ///must outlive the allocation, so use a string literal or intern_memory_tag. A pointer rather than a string, as handles are copied per kernel argument
+        const char* memory_tag = nullptr;
 
         cl_mem_flags get_flags();
         std::optional<mem_object> get_parent();
@@ -257,6 +268,13 @@ namespace cl
     };*/
 
     struct kernel;
+    struct event;
+    struct managed_buffer;
+    struct transfer_route;
+
+    ///for kernels launched by name on a queue with a transfer queue. Adds the last routed transfer on mem to deps, and returns the route to record the kernel against
+    transfer_route* get_transfer_deps(command_queue& cqueue, cl_mem mem, std::vector<event>& deps);
+    void record_compute_use(transfer_route* route, cl_mem mem, const event& evt);
 
     struct callback_helper_base
     {
@@ -265,6 +283,11 @@ namespace cl
             assert(false);
         }
 
+        ///called by command_queue::exec before arguments are set, for arguments which must be made resident on the device first
+        virtual void prepare(command_queue& cqueue, std::vector<event>& deps, uint64_t exec_id){}
+        ///called with the kernel's event once it has been enqueued
+        virtual void used(const event& evt){}
+
         virtual ~callback_helper_base(){}
     };
 
@@ -283,6 +306,8 @@ namespace cl
         T t;
         decltype(to_opencl_from_array(fetch_array_type(std::declval<T>()))) native_type;
 
+        transfer_route* route = nullptr;
+
         callback_helper_generic(T in) : t(std::move(in)){native_type = to_opencl_from_array(fetch_array_type(t));}
 
         void callback(cl_kernel kern, int idx) override
@@ -292,6 +317,21 @@ namespace cl
             clSetKernelArg(kern, idx, size, ptr);
         }
 
+        void prepare(command_queue& cqueue, std::vector<event>& deps, uint64_t exec_id) override
+        {
+            if constexpr(std::is_base_of_v<mem_object, T>)
+                route = get_transfer_deps(cqueue, t.native_mem_object.data, deps);
+        }
+
+        void used(const event& evt) override
+        {
+            if constexpr(std::is_base_of_v<mem_object, T>)
+            {
+                if(route)
+                    record_compute_use(route, t.native_mem_object.data, evt);
+            }
+        }
+
         std::pair<void*, size_t> get_ptr()
         {
             if constexpr(std::is_base_of_v<command_queue, T>)
@@ -335,6 +375,8 @@ namespace cl
 
             arg_list.push_back(std::move(owned));
         }
+
+        void push_back(const managed_buffer& val);
     };
 
     struct event
@@ -350,6 +392,25 @@ namespace cl
     inline
     cl_event type_to_opencl(const event& e){return e.native_event.data;}
 
+    ///how event::block, wait_all and wait_any wait. Some drivers sleep with coarse granularity inside clWaitForEvents,
+    ///so polling the execution status trades cpu time for latency. With both budgets at 0 the driver's wait is used
+    struct wait_policy
+    {
+        ///busy poll for this long first
+        int64_t spin_us = 0;
+        ///then poll with a yield between checks for this long, before falling back to the driver's wait. Negative polls forever
+        int64_t yield_us = 0;
+    };
+
+    ///process wide, defaults to the driver's wait
+    void set_wait_policy(const wait_policy& policy);
+    wait_policy get_wait_policy();
+
+    ///events which complete with an error status count as finished. Null events are skipped
+    void wait_all(std::span<const event> events, const wait_policy& policy = get_wait_policy());
+    ///returns the index of an event which has finished, or -1 if there are no non null events
+    int wait_any(std::span<const event> events, const wait_policy& policy = get_wait_policy());
+
     struct context;
     struct kernel;
 
@@ -364,6 +425,8 @@ namespace cl
             std::latch latch{1};
             std::atomic_bool cancelled{false};
             std::map<std::string, cl::kernel> built_kernels;
+            ///set if the background build failed, including the build log. Read after the latch
+            std::optional<std::string> build_error;
         };
 
         base<cl_program, clRetainProgram, clReleaseProgram> native_program;
@@ -379,11 +442,16 @@ namespace cl
         std::string get_binary();
 
         void build(const context& ctx, const std::string& options);
+        ///throws the build error, if the build failed
         void ensure_built();
         bool is_built();
         void cancel(); ///purely optional
     };
 
+    ///every file which the sources transitively #include, resolved against the including file's directory then the -I paths in options
+    ///includes which don't resolve to a file, such as builtin headers, are skipped. Used to key the program cache
+    std::vector<std::string> get_include_dependencies(const std::vector<std::string>& data, bool is_file, const std::string& options);
+
     program build_program_with_cache(const context& ctx, const std::vector<std::string>& data, bool is_file = true, const std::string& options = "", const std::vector<std::string>& extra_deps = {}, const std::string& cache_name = "");
 
     struct kernel
@@ -428,18 +496,132 @@ namespace cl
         bool promote_pending(const std::string& name);
     };
 
+    struct memory_snapshot
+    {
+        struct usage
+        {
+            int64_t live_bytes = 0;
+            int64_t peak_bytes = 0;
+            int64_t live_allocations = 0;
+        };
+
+        std::map<std::string, usage> tags;
+        int64_t live_bytes = 0;
+        int64_t peak_bytes = 0;
+        int64_t buffer_bytes = 0;
+        int64_t image_bytes = 0;
+        int64_t device_global_mem_size = 0;
+    };
+
+    ///live device allocations made through buffer, image and gl_rendertexture. Sub buffers and gl shared textures
+    ///don't allocate, so aren't counted. Allocations are removed from the total when the driver destroys the cl_mem
+    struct memory_tracker
+    {
+        std::mutex mut;
+        std::map<std::string, memory_snapshot::usage> tags;
+        int64_t live_bytes = 0;
+        int64_t peak_bytes = 0;
+        int64_t buffer_bytes = 0;
+        int64_t image_bytes = 0;
+
+        int64_t device_global_mem_size = 0;
+        ///prints a warning once each time live allocations cross this fraction of CL_DEVICE_GLOBAL_MEM_SIZE
+        double warn_fraction = 0.9;
+        bool warned = false;
+
+        void add(const std::string& tag, int64_t bytes, bool is_image);
+        void remove(const std::string& tag, int64_t bytes, bool is_image);
+
+        memory_snapshot snapshot();
+    };
+
+    ///everything the toolkit asks of a device, queried once per device by get_device_caps. Version numbers are from CL_DEVICE_VERSION
+    struct device_caps
+    {
+        struct string_hash
+        {
+            using is_transparent = void;
+
+            size_t operator()(std::string_view in) const {return std::hash<std::string_view>{}(in);}
+        };
+
+        std::string name;
+        std::string vendor;
+        std::string version;
+        std::string driver_version;
+        int version_major = 1;
+        int version_minor = 0;
+
+        std::string extensions_string;
+        std::unordered_set<std::string, string_hash, std::equal_to<>> extensions;
+
+        cl_uint compute_units = 1;
+        size_t max_work_group_size = 1;
+        std::vector<size_t> max_work_item_sizes;
+
+        cl_ulong global_mem_size = 0;
+        cl_ulong local_mem_size = 0;
+        cl_ulong max_mem_alloc_size = 0;
+        cl_ulong max_constant_buffer_size = 0;
+        ///in bytes, CL_DEVICE_MEM_BASE_ADDR_ALIGN is in bits
+        int64_t mem_base_addr_align = 1;
+
+        bool image_support = false;
+        size_t image2d_max_width = 0;
+        size_t image2d_max_height = 0;
+        size_t image3d_max_width = 0;
+        size_t image3d_max_height = 0;
+        size_t image3d_max_depth = 0;
+
+        ///zero below OpenCL 2.0
+        cl_uint queue_on_device_preferred_size = 0;
+        cl_uint queue_on_device_max_size = 0;
+
+        device_caps(){}
+        explicit device_caps(cl_device_id id);
+
+        ///an exact match against one of the space separated names in CL_DEVICE_EXTENSIONS
+        bool has_extension(std::string_view ext) const {return extensions.find(ext) != extensions.end();}
+        bool is_at_least(int major, int minor) const {return version_major > major || (version_major == major && version_minor >= minor);}
+    };
+
+    ///memoised per device for the life of the program
+    std::shared_ptr<const device_caps> get_device_caps(cl_device_id id);
+
+    struct deferred_context_creation;
+
     struct context
     {
         std::shared_ptr<shared_kernel_info> shared;
+        std::shared_ptr<memory_tracker> memory;
+        std::shared_ptr<managed_pool> managed;
         cl_device_id selected_device;
         std::string platform_name;
+        ///selected_device's capabilities. Like selected_device, only valid once a deferred context has been created
+        std::shared_ptr<const device_caps> caps;
 
         base<cl_context, clRetainContext, clReleaseContext> native_context;
+        ///set while a deferred context is still being created
+        std::shared_ptr<deferred_context_creation> pending;
 
         context();
-        explicit context(bool); ///defer context creation
+        ///if deferred, the platform and driver are initialised on a background thread, and selected_device, platform_name
+        ///and native_context are only valid after ensure_created. Must still be constructed on the thread with the gl context current
+        explicit context(bool deferred);
+
+        ///blocks until a deferred context exists. Queues, buffers, images and async builds call this, so a deferred context
+        ///can be handed to them directly. Functions which take a const context& need it to have been created first
+        ///this fills in the context object it's called on, unsynchronised. Separate copies are safe to resolve on separate threads,
+        ///but a single deferred context object must be resolved before it's shared between threads
+        void ensure_created();
+        ///never blocks
+        bool is_ready();
+        const device_caps& get_caps();
 
         void register_program(program& p);
+        ///atomically with respect to exec, removes previous_kernels and registers p's kernels in their place
+        ///kernels which were already enqueued keep running
+        void replace_program(const std::vector<std::string>& previous_kernels, program& p);
         //void register_program(program& p, const std::vector<std::string>& provides_kernels);
         void deregister_program(int idx);
 
@@ -448,6 +630,8 @@ namespace cl
 
         kernel fetch_kernel(std::string_view name);
         void remove_kernel(std::string_view name);
+
+        memory_snapshot get_memory_snapshot();
     };
 
     void async_build_and_cache(cl::context ctx, std::function<std::string(void)> func, std::vector<std::string> produces_kernels, std::string options = "");
@@ -459,12 +643,86 @@ namespace cl
 
     bool requires_memory_barrier(cl_mem in1, cl_mem in2);
 
+    ///recycles host side readback targets, so that per frame readbacks don't churn the allocator
+    ///storage goes back to the pool when the last shared_ptr to it is dropped. One pool per element type, shared by every context
+    template<typename T>
+    struct readback_pool
+    {
+        std::mutex mut;
+        std::vector<std::vector<T>> free_list;
+        int64_t free_bytes = 0;
+        ///released storage past this is freed rather than kept
+        int64_t max_free_bytes = 256 * 1024 * 1024;
+        int max_free_count = 16;
+
+        ///never destroyed, as storage may be released during static destruction
+        static readback_pool& get()
+        {
+            static readback_pool* pool = new readback_pool;
+
+            return *pool;
+        }
+
+        std::shared_ptr<std::vector<T>> acquire(int64_t elements)
+        {
+            std::vector<T> storage;
+
+            {
+                std::scoped_lock guard(mut);
+
+                int best = -1;
+
+                for(int i=0; i < (int)free_list.size(); i++)
+                {
+                    if((int64_t)free_list[i].capacity() < elements)
+                        continue;
+
+                    if(best == -1 || free_list[i].capacity() < free_list[best].capacity())
+                        best = i;
+                }
+
+                if(best != -1)
+                {
+                    storage = std::move(free_list[best]);
+                    free_list.erase(free_list.begin() + best);
+                    free_bytes -= storage.capacity() * sizeof(T);
+                }
+            }
+
+            storage.resize(elements);
+
+            return std::shared_ptr<std::vector<T>>(new std::vector<T>(std::move(storage)), [](std::vector<T>* v)
+            {
+                readback_pool::get().release(std::move(*v));
+                delete v;
+            });
+        }
+
+        void release(std::vector<T>&& storage)
+        {
+            int64_t bytes = storage.capacity() * sizeof(T);
+
+            if(bytes == 0)
+                return;
+
+            std::scoped_lock guard(mut);
+
+            if(free_bytes + bytes > max_free_bytes || (int)free_list.size() >= max_free_count)
+                return;
+
+            free_bytes += bytes;
+            free_list.push_back(std::move(storage));
+        }
+    };
+
     template<typename T>
     struct read_info
     {
         int64_t elements = 0;
         T* data = nullptr;
         event evt;
+        ///data points into this, which is returned to the readback_pool on consume
+        std::shared_ptr<std::vector<T>> storage;
 
         void consume()
         {
@@ -472,7 +730,7 @@ namespace cl
                 return;
 
             evt.block();
-            delete [] data;
+            storage = nullptr;
             data = nullptr;
         }
 
@@ -491,25 +749,49 @@ namespace cl
         }
     };
 
+    ///data is drawn from readback_pool<T>, and goes back to it when the last copy of this is destroyed
+    ///view, or to_vec into a vector which is kept between frames, read without allocating. to_vec() allocates the vector it returns
     template<typename T>
     struct read_info2
     {
         std::shared_ptr<std::vector<T>> data;
         event evt;
 
-        std::vector<T> to_vec()
+        ///valid for as long as this is
+        std::span<const T> view()
         {
             assert(data);
             evt.block();
 
-            return std::move(*data);
+            return std::span<const T>(data->data(), data->size());
+        }
+
+        ///reuses out's capacity, and returns the storage to the pool straight away
+        void to_vec(std::vector<T>& out)
+        {
+            std::span<const T> in = view();
+
+            out.assign(in.begin(), in.end());
+            data = nullptr;
+        }
+
+        std::vector<T> to_vec()
+        {
+            std::vector<T> ret;
+            to_vec(ret);
+
+            return ret;
         }
     };
 
+    struct sub_buffer_cache;
+
     struct buffer : mem_object
     {
         base<cl_context, clRetainContext, clReleaseContext> native_context;
         int64_t alloc_size = 0;
+        ///sub buffers handed out by as_read_only, as_write_only and slice, shared by every copy of this handle and dropped on alloc
+        std::shared_ptr<sub_buffer_cache> views;
 
         buffer(cl::context& ctx);
 
@@ -532,7 +814,7 @@ namespace cl
             return write(write_on, (const char*)data.data(), data.size() * sizeof(T));
         }
 
-        event write_async(command_queue& write_on, const char* ptr, int64_t bytes);
+        event write_async(command_queue& write_on, const char* ptr, int64_t bytes, const std::vector<cl::event>& deps = {});
 
         template<typename T>
         event write_async(command_queue& write_on, std::span<T> data)
@@ -565,13 +847,18 @@ namespace cl
 
             assert(elements * sizeof(T) <= alloc_size);
 
-            ret.data = new T[elements];
+            ret.storage = readback_pool<T>::get().acquire(elements);
+            ret.data = ret.storage->data();
             ret.evt = read_async(read_on, (char*)ret.data, elements * sizeof(T), deps);
             ret.elements = elements;
 
             return ret;
         }
 
+        ///stores floats as cl_half, converted on the host
+        cl::event write_as_half(command_queue& write_on, std::span<const float> data);
+        std::vector<float> read_half_as_float(command_queue& read_on);
+
         cl::event set_to_zero(command_queue& write_on);
         cl::event fill(command_queue& write_on, const void* pattern, size_t pattern_size, size_t size, const std::vector<cl::event>& deps = std::vector<cl::event>());
 
@@ -612,8 +899,7 @@ namespace cl
             if(elements == 0)
                 return ret;
 
-            ret.data = std::make_shared<std::vector<T>>();
-            ret.data->resize(elements);
+            ret.data = readback_pool<T>::get().acquire(elements);
 
             ret.evt = read_async(read_on, (char*)ret.data->data(), elements * sizeof(T), {});
 
@@ -626,7 +912,93 @@ namespace cl
         cl::buffer as_device_write_only();
         cl::buffer as_device_inaccessible();
 
+        ///offset must be a multiple of get_sub_buffer_alignment, otherwise this throws. Views are cached by (offset, length, flags)
         cl::buffer slice(int64_t offset, int64_t length, cl_mem_flags flags = 0);
+        ///in bytes, the strictest CL_DEVICE_MEM_BASE_ADDR_ALIGN of the context's devices
+        int64_t get_sub_buffer_alignment();
+    };
+
+    ///device memory which the toolkit may spill to host memory when device memory is under pressure
+    ///it is made resident again before any exec by name that it's passed to, and by read and write
+    ///opt in, a plain buffer is never evicted
+    struct managed_buffer
+    {
+        struct state
+        {
+            std::optional<cl::buffer> device;
+            ///contents while evicted
+            std::vector<char> host;
+            ///the readback into host, which eviction doesn't wait for. host must not be read or freed until it completes
+            cl::event evicting;
+            int64_t alloc_size = 0;
+            const char* memory_tag = nullptr;
+
+            cl::event last_use;
+            uint64_t last_use_tick = 0;
+            ///an exec never evicts a buffer that it uses itself
+            uint64_t locked_by_exec = 0;
+
+            ~state();
+        };
+
+        cl::context ctx;
+        std::shared_ptr<state> data;
+        std::shared_ptr<managed_pool> pool;
+
+        managed_buffer(cl::context& ctx);
+
+        void alloc(int64_t bytes);
+        int64_t alloc_size() const;
+        bool is_resident();
+
+        cl::event write(command_queue& write_on, const char* ptr, int64_t bytes);
+        void read(command_queue& read_on, char* ptr, int64_t bytes);
+
+        template<typename T>
+        cl::event write(command_queue& write_on, const std::vector<T>& data)
+        {
+            if(data.size() == 0)
+                return cl::event();
+
+            return write(write_on, (const char*)data.data(), data.size() * sizeof(T));
+        }
+
+        template<typename T>
+        std::vector<T> read(command_queue& read_on)
+        {
+            std::vector<T> ret;
+
+            if(alloc_size() == 0)
+                return ret;
+
+            assert((alloc_size() % sizeof(T)) == 0);
+
+            ret.resize(alloc_size() / sizeof(T));
+
+            read(read_on, (char*)&ret[0], alloc_size());
+
+            return ret;
+        }
+
+        ///any upload required is appended to deps. The returned handle is only valid until the next eviction
+        cl::buffer make_resident(command_queue& cqueue, std::vector<cl::event>& deps, uint64_t exec_id = 0);
+        ///enqueues the readback without waiting for it
+        void evict(command_queue& cqueue);
+    };
+
+    ///per context bookkeeping for managed buffers. Eviction is least recently used first
+    struct managed_pool
+    {
+        std::mutex mut;
+        std::vector<std::weak_ptr<managed_buffer::state>> buffers;
+        std::shared_ptr<memory_tracker> memory;
+
+        ///managed buffers are evicted to keep all live device allocations under this. 0 means 90% of CL_DEVICE_GLOBAL_MEM_SIZE
+        int64_t budget_bytes = 0;
+        uint64_t tick = 0;
+
+        int64_t evictions = 0;
+        int64_t uploads = 0;
     };
 
     inline
@@ -639,6 +1011,11 @@ namespace cl
 
         void read_impl(cl::command_queue& cqueue, const vec<4, size_t>& origin, const vec<4, size_t>& region, char* out);
 
+        ///whole image readbacks, converted on the host from the image's channel type
+        ///the image must be CL_RGBA with CL_FLOAT, CL_HALF_FLOAT or CL_UNORM_INT8 channels
+        std::vector<float> read_float4(cl::command_queue& cqueue);
+        std::vector<uint8_t> read_rgba8(cl::command_queue& cqueue, bool srgb = false);
+
         template<int N, typename T>
         std::vector<T> read(cl::command_queue& cqueue, const vec<N, size_t>& origin, const vec<N, size_t>& region)
         {
@@ -754,6 +1131,11 @@ namespace cl
             write_impl(write_on, ptr, forigin, fregion);
         }
 
+        ///whole image uploads, converted on the host to the image's channel type. Same format requirements as read_float4
+        void write_float4(command_queue& write_on, const float* rgba);
+        ///srgb decodes the colour channels to linear
+        void write_rgba8(command_queue& write_on, const uint8_t* rgba, bool srgb = false);
+
         /*template<typename T>
         void write(command_queue& write_on, const std::vector<T>& data)
         {
@@ -827,16 +1209,33 @@ namespace cl
         base<cl_context, clRetainContext, clReleaseContext> native_context;
 
         std::shared_ptr<shared_kernel_info> shared;
+        ///null unless enable_transfer_queue has been called
+        std::shared_ptr<transfer_route> transfer;
 
         command_queue(context& ctx, cl_command_queue_properties props = 0);
 
+        ///routes buffer::write_async, read_async and copy on this queue to a second queue, so that they can overlap with kernels
+        ///ordering is kept per buffer, against kernels executed by name. Kernels executed directly with a cl::kernel aren't tracked
+        void enable_transfer_queue(context& ctx);
+
         event enqueue_marker(const std::vector<event>& deps);
 
         ///apparently past me was not very bright, and used an int max work size here
-        event exec(cl::kernel& kern, const std::vector<size_t>& global_ws, const std::vector<size_t>& local_ws, const std::vector<event>& deps = {});
-        event exec(const std::string& kname, args& pack, const std::vector<size_t>& global_ws, const std::vector<size_t>& local_ws, const std::vector<event>& deps);
+        ///global_ws is rounded up to a multiple of local_ws, so kernels must bounds check get_global_id against their real size
+        ///global_offset is either empty, or one entry per dimension. Offsets aren't rounded
+        event exec(cl::kernel& kern, const std::vector<size_t>& global_ws, const std::vector<size_t>& local_ws, const std::vector<event>& deps = {}, const std::vector<size_t>& global_offset = {});
+        event exec(const std::string& kname, args& pack, const std::vector<size_t>& global_ws, const std::vector<size_t>& local_ws, const std::vector<event>& deps, const std::vector<size_t>& global_offset = {});
         event exec(const std::string& kname, args& pack, const std::vector<size_t>& global_ws, const std::vector<size_t>& local_ws);
 
+        ///called after each chunk is enqueued, with how many work items along the split dimension have been enqueued so far
+        using chunk_callback = std::function<void(const event& chunk, size_t items_done, size_t items_total)>;
+
+        ///splits the last dimension of global_ws into slices of at most max_items_per_chunk work items, each a separate dispatch
+        ///with the queue flushed in between, so that a huge range doesn't trip a driver watchdog or hog the device
+        ///slices are whole multiples of local_ws, so no work item runs twice. Kernels see the same get_global_id as with exec
+        event exec_chunked(const std::string& kname, args& pack, const std::vector<size_t>& global_ws, const std::vector<size_t>& local_ws, size_t max_items_per_chunk,
+                           const std::vector<event>& deps = {}, const chunk_callback& on_chunk = nullptr);
+
         template<typename T>
         event exec(const std::string& kname, args& pack, const T& global_ws, const T& local_ws, const std::vector<event>& deps = {})
         {
@@ -859,9 +1258,64 @@ namespace cl
     inline
     cl_command_queue type_to_opencl(command_queue& in){return in.native_command_queue.data;};
 
+    struct transfer_route
+    {
+        command_queue queue;
+        std::mutex mut;
+        ///the last routed transfer, and the last kernel on the compute queue, to touch each buffer
+        ///keyed on the root allocation, so that sub-buffer views are ordered against their parent and each other
+        std::map<cl_mem, event> last_transfer;
+        std::map<cl_mem, event> last_compute;
+
+        transfer_route(context& ctx);
+    };
+
+    ///the device's default on-device queue, for kernels which use enqueue_kernel. Needs OpenCL 2.0, and kernels built with -cl-std=CL2.0
+    ///kernels reach it with get_default_queue(), or as a queue_t argument by pushing it into cl::args like any other command_queue
+    ///See the device enqueue helpers in device_enqueue.cl
+    ///it can't be used with the host side functions of command_queue, which are only inherited for the handles
     struct device_command_queue : command_queue
     {
-        device_command_queue(context& ctx, cl_command_queue_properties props = 0);
+        ///in bytes, the device's preferred size unless requested_size is non zero. Clamped to the device's maximum
+        cl_uint queue_size = 0;
+
+        ///throws if the device doesn't support device side enqueue
+        device_command_queue(context& ctx, cl_command_queue_properties props = 0, cl_uint requested_size = 0);
+    };
+
+    namespace gl_transfer_format
+    {
+        enum type
+        {
+            FLOAT,
+            HALF_FLOAT,
+            UNORM8,
+        };
+    }
+
+    ///only used when cl_khr_gl_sharing is unavailable. The cl image is read back asynchronously into one of these
+    ///and uploaded to the texture a frame later, so neither side has to stall
+    struct gl_unpack_ring
+    {
+        struct slot
+        {
+            GLuint pbo = 0;
+            void* mapped = nullptr;
+            GLsync fence = nullptr;
+            cl::event read_event;
+            bool pending = false;
+        };
+
+        std::vector<slot> slots;
+        int64_t bytes = 0;
+        bool persistent = false;
+        int next = 0;
+
+        gl_unpack_ring(int count, int64_t bytes);
+        ~gl_unpack_ring();
+
+        gl_unpack_ring(const gl_unpack_ring&) = delete;
+        gl_unpack_ring& operator=(const gl_unpack_ring&) = delete;
     };
 
     struct gl_rendertexture : image_base
@@ -872,8 +1326,17 @@ namespace cl
 
         GLuint texture_id = 0;
 
+        gl_transfer_format::type transfer_format = gl_transfer_format::FLOAT;
+        int fallback_buffers = 0;
+        std::shared_ptr<gl_unpack_ring> unpack_ring;
+
         gl_rendertexture(context& ctx);
 
+        ///only affects the non sharing path. If the texture has already been created and the format changes, the CL side image is reallocated
+        ///which throws while acquired. Pass about_to_recreate if create_from_texture follows, to skip reallocating at the old size
+        ///buffers == 0 performs a blocking upload in unacquire, otherwise uploads lag one frame behind
+        void set_fallback_transfer(gl_transfer_format::type format, int buffers = 2, bool about_to_recreate = false);
+
         void create(int w, int h);
         void create_from_texture(GLuint texture_id);
         void create_from_texture_with_mipmaps(GLuint texture_id, int mip_level);
@@ -884,6 +1347,10 @@ namespace cl
 
         event acquire(command_queue& cqueue, const std::vector<cl::event>& events);
         event unacquire(command_queue& cqueue, const std::vector<cl::event>& events);
+
+    private:
+        ///the non sharing path's CL image, sized from sizes, in transfer_format
+        void create_fallback_image();
     };
 
     template<int N, typename T>
@@ -921,7 +1388,98 @@ namespace cl
         }
     };
 
+    struct ring_stats
+    {
+        int64_t acquires = 0;
+        int64_t stalls = 0;
+        double stall_time_s = 0;
+        double max_stall_s = 0;
+    };
+
+    ///blocks until every event in a slot is complete, recording whether we actually had to wait. Clears the slot
+    void wait_for_ring_slot(std::vector<cl::event>& in_flight, ring_stats& stats);
+
+    ///like flip, but each slot remembers the gpu work that touched it, so that cycling only waits if
+    ///the slot we're about to reuse is still in flight
+    template<typename T, int N>
+    struct frame_ring
+    {
+        static_assert(N > 0);
+
+        int counter = 0;
+        std::array<T, N> buffers;
+        std::array<std::vector<cl::event>, N> in_flight;
+        ring_stats stats;
+
+        template<typename... V>
+        frame_ring(V&&... args) : buffers{std::forward<V>(args)...}
+        {
+
+        }
+
+        template<typename U, typename... V>
+        void apply(U in, V&&... args)
+        {
+            for(int i=0; i < N; i++)
+            {
+                std::invoke(in, buffers[i], std::forward<V>(args)...);
+            }
+        }
+
+        T& current()
+        {
+            return buffers[counter];
+        }
+
+        ///record gpu work that reads or writes the current slot
+        void track(const cl::event& evt)
+        {
+            if(evt.native_event.data == nullptr)
+                return;
+
+            in_flight[counter].push_back(evt);
+        }
+
+        ///events for work still touching the current slot, for use as dependencies
+        const std::vector<cl::event>& current_events()
+        {
+            return in_flight[counter];
+        }
+
+        T& acquire_next()
+        {
+            counter++;
+            counter %= N;
+
+            wait_for_ring_slot(in_flight[counter], stats);
+
+            return buffers[counter];
+        }
+
+        ///waits for every slot, eg before resizing or destroying the underlying resources
+        void drain()
+        {
+            for(int i=0; i < N; i++)
+            {
+                ring_stats ignored;
+
+                wait_for_ring_slot(in_flight[i], ignored);
+            }
+        }
+    };
+
+    ///whole buffers, which must be the same size
     event copy(cl::command_queue& cqueue, cl::buffer& source, cl::buffer& dest, const std::vector<cl::event>& events = {});
+    ///source and dest may be the same buffer, as long as the ranges don't overlap
+    event copy(cl::command_queue& cqueue, cl::buffer& source, int64_t source_offset, cl::buffer& dest, int64_t dest_offset, int64_t bytes, const std::vector<cl::event>& events = {});
+
+    ///region is in bytes by rows by slices, origins likewise. Pitches of 0 are tightly packed rows and slices of the region
+    event copy_rect(cl::command_queue& cqueue, cl::buffer& source, vec3i source_origin, cl::buffer& dest, vec3i dest_origin, vec3i region,
+                    size_t source_row_pitch = 0, size_t source_slice_pitch = 0, size_t dest_row_pitch = 0, size_t dest_slice_pitch = 0, const std::vector<cl::event>& events = {});
+
+    ///image is any image, or a gl_rendertexture. Pixels in the buffer are tightly packed in the image's format, origin and region are in pixels
+    event copy_buffer_to_image(cl::command_queue& cqueue, cl::buffer& source, int64_t source_offset, cl::mem_object& image, vec3i origin, vec3i region, const std::vector<cl::event>& events = {});
+    event copy_image_to_buffer(cl::command_queue& cqueue, cl::mem_object& image, vec3i origin, vec3i region, cl::buffer& dest, int64_t dest_offset, const std::vector<cl::event>& events = {});
 
     template<typename T, typename U>
     void copy_image(cl::command_queue& cqueue, T& src, U& dst, vec3i origin, vec3i region)
@@ -950,6 +1508,7 @@ namespace cl
     bool supports_extension(cl_device_id id, const std::string& name);
     bool supports_extension(context& ctx, const std::string& name);
 
+    ///queries the device every call, prefer get_device_caps for anything on a hot path
     std::vector<char> get_device_info(cl_device_id id, cl_device_info param);
 
     template<typename T>
@@ -0,0 +1,729 @@
+#include "config.hpp"
+
+#ifndef NO_OPENCL
+
+#include "opencl_algo.hpp"
+#include <mutex>
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+#include <limits>
+#include <bit>
+
+namespace
+{
+const char* algo_source = R"(
+#ifdef cl_khr_fp16
+#pragma OPENCL EXTENSION cl_khr_fp16 : enable
+#endif
+
+#ifdef cl_khr_fp64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+
+#ifdef ALGO_SUBGROUPS
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+#endif
+
+#define CAT2(a, b) a##_##b
+#define CAT(a, b) CAT2(a, b)
+
+T combine(T a, T b, int op)
+{
+    if(op == 1)
+        return min(a, b);
+
+    if(op == 2)
+        return max(a, b);
+
+    return a + b;
+}
+
+T identity(int op)
+{
+    if(op == 1)
+        return IDENT_MIN;
+
+    if(op == 2)
+        return IDENT_MAX;
+
+    return (T)0;
+}
+
+///grid stride accumulate, then reduce within the work group. Run a second time with a single group over the partials
+__kernel __attribute__((reqd_work_group_size(WG, 1, 1)))
+void CAT(algo_reduce, SUFFIX)(__global const T* in, __global T* out, ulong n, int op)
+{
+    __local T scratch[WG];
+
+    size_t lid = get_local_id(0);
+
+    T acc = identity(op);
+
+    for(size_t i = get_global_id(0); i < n; i += get_global_size(0))
+    {
+        acc = combine(acc, in[i], op);
+    }
+
+    #ifdef ALGO_SUBGROUPS
+    if(op == 1)
+        acc = sub_group_reduce_min(acc);
+    else if(op == 2)
+        acc = sub_group_reduce_max(acc);
+    else
+        acc = sub_group_reduce_add(acc);
+
+    if(get_sub_group_local_id() == 0)
+        scratch[get_sub_group_id()] = acc;
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    if(lid == 0)
+    {
+        T total = identity(op);
+
+        for(uint i=0; i < get_num_sub_groups(); i++)
+        {
+            total = combine(total, scratch[i], op);
+        }
+
+        out[get_group_id(0)] = total;
+    }
+    #else
+    scratch[lid] = acc;
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for(uint stride = WG / 2; stride > 0; stride >>= 1)
+    {
+        if(lid < stride)
+            scratch[lid] = combine(scratch[lid], scratch[lid + stride], op);
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if(lid == 0)
+        out[get_group_id(0)] = scratch[0];
+    #endif
+}
+
+///scans each block of WG elements in local memory, and writes the total of every block to block_sums
+__kernel __attribute__((reqd_work_group_size(WG, 1, 1)))
+void CAT(algo_scan_block, SUFFIX)(__global const T* in, __global T* out, __global T* block_sums, ulong n, int inclusive)
+{
+    __local T scratch[WG];
+
+    size_t gid = get_global_id(0);
+    size_t lid = get_local_id(0);
+
+    scratch[lid] = gid < n ? in[gid] : (T)0;
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for(uint offset = 1; offset < WG; offset <<= 1)
+    {
+        T add = lid >= offset ? scratch[lid - offset] : (T)0;
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        scratch[lid] += add;
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+    }
+
+    if(gid < n)
+    {
+        if(inclusive)
+            out[gid] = scratch[lid];
+        else
+            out[gid] = lid > 0 ? scratch[lid - 1] : (T)0;
+    }
+
+    if(lid == WG - 1)
+        block_sums[get_group_id(0)] = scratch[WG - 1];
+}
+
+///block_offsets is the exclusive scan of block_sums
+__kernel
+void CAT(algo_scan_offset, SUFFIX)(__global T* data, __global const T* block_offsets, ulong n)
+{
+    size_t gid = get_global_id(0);
+
+    if(gid >= n)
+        return;
+
+    data[gid] += block_offsets[gid / WG];
+}
+
+__kernel
+void CAT(algo_compact, SUFFIX)(__global const T* in, __global const uint* flags, __global const uint* positions, __global T* out, __global uint* out_count, ulong n)
+{
+    size_t gid = get_global_id(0);
+
+    if(gid >= n)
+        return;
+
+    uint keep = flags[gid];
+
+    if(keep)
+        out[positions[gid]] = in[gid];
+
+    if(gid == n - 1)
+        out_count[0] = positions[gid] + keep;
+}
+)";
+
+const char* radix_source = R"(
+#define CAT2(a, b) a##_##b
+#define CAT(a, b) CAT2(a, b)
+
+#define MAX_RADIX 256
+
+///each group owns a contiguous tile of the input, and counts how many of its keys fall into each digit
+///hist is digit major, so a single exclusive scan over it gives every group its write offset for every digit
+__kernel __attribute__((reqd_work_group_size(WG, 1, 1)))
+void CAT(algo_radix_histogram, SUFFIX)(__global const K* keys, __global uint* hist, ulong n, ulong tile, uint shift, uint radix, uint num_groups)
+{
+    __local uint local_hist[MAX_RADIX];
+
+    size_t lid = get_local_id(0);
+    size_t group = get_group_id(0);
+
+    for(uint d = lid; d < radix; d += WG)
+        local_hist[d] = 0;
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    ulong start = group * tile;
+    ulong end = min(start + tile, n);
+
+    for(ulong i = start + lid; i < end; i += WG)
+    {
+        uint digit = (uint)((keys[i] >> shift) & (K)(radix - 1));
+
+        atomic_inc(&local_hist[digit]);
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    for(uint d = lid; d < radix; d += WG)
+        hist[d * num_groups + group] = local_hist[d];
+}
+
+///walks the tile a chunk of WG elements at a time. Each chunk is stably sorted by digit in local memory with one
+///split per bit, then written out to the group's running offset for each digit, which keeps the sort stable overall
+__kernel __attribute__((reqd_work_group_size(WG, 1, 1)))
+void CAT(algo_radix_scatter, SUFFIX)(__global const K* keys_in, __global K* keys_out, __global const V* values_in, __global V* values_out,
+                                     __global const uint* offsets, ulong n, ulong tile, uint shift, uint bits, uint num_groups, int has_values)
+{
+    __local K lkeys[WG];
+    __local ulong lidx[WG];
+    __local uint ldigit[WG];
+    __local uint lvalid[WG];
+    __local uint lscan[WG];
+
+    __local uint running[MAX_RADIX];
+    __local uint chunk_start[MAX_RADIX];
+    __local uint chunk_count[MAX_RADIX];
+
+    uint radix = 1u << bits;
+
+    size_t lid = get_local_id(0);
+    size_t group = get_group_id(0);
+
+    for(uint d = lid; d < radix; d += WG)
+        running[d] = offsets[d * num_groups + group];
+
+    ulong start = group * tile;
+    ulong end = min(start + tile, n);
+
+    for(ulong base = start; base < end; base += WG)
+    {
+        ulong idx = base + lid;
+        uint valid = idx < end;
+
+        K key = valid ? keys_in[idx] : (K)0;
+        ///invalid lanes are always at the end of the chunk, so as the largest digit they stay behind every valid element
+        uint digit = valid ? (uint)((key >> shift) & (K)(radix - 1)) : radix - 1;
+
+        for(uint b = 0; b < bits; b++)
+        {
+            uint is_zero = ((digit >> b) & 1) == 0;
+
+            barrier(CLK_LOCAL_MEM_FENCE);
+
+            lscan[lid] = is_zero;
+
+            barrier(CLK_LOCAL_MEM_FENCE);
+
+            for(uint offset = 1; offset < WG; offset <<= 1)
+            {
+                uint add = lid >= offset ? lscan[lid - offset] : 0;
+
+                barrier(CLK_LOCAL_MEM_FENCE);
+
+                lscan[lid] += add;
+
+                barrier(CLK_LOCAL_MEM_FENCE);
+            }
+
+            uint zeros_before = lscan[lid] - is_zero;
+            uint total_zeros = lscan[WG - 1];
+
+            uint dst = is_zero ? zeros_before : total_zeros + (lid - zeros_before);
+
+            lkeys[dst] = key;
+            lidx[dst] = idx;
+            ldigit[dst] = digit;
+            lvalid[dst] = valid;
+
+            barrier(CLK_LOCAL_MEM_FENCE);
+
+            key = lkeys[lid];
+            idx = lidx[lid];
+            digit = ldigit[lid];
+            valid = lvalid[lid];
+        }
+
+        for(uint d = lid; d < radix; d += WG)
+        {
+            chunk_count[d] = 0;
+            chunk_start[d] = 0;
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if(valid)
+            atomic_inc(&chunk_count[digit]);
+
+        if(valid && (lid == 0 || ldigit[lid - 1] != digit))
+            chunk_start[digit] = lid;
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if(valid)
+        {
+            ulong out = running[digit] + (lid - chunk_start[digit]);
+
+            keys_out[out] = key;
+
+            if(has_values)
+                values_out[out] = values_in[idx];
+        }
+
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        for(uint d = lid; d < radix; d += WG)
+            running[d] += chunk_count[d];
+    }
+}
+)";
+
+const char* copy_source = R"(
+///ranges are (source offset, dest offset, bytes) triples. Ranges which are 16 byte aligned throughout are moved as uint4
+__kernel
+void algo_copy_ranges(__global const uchar* source, __global uchar* dest, __global const ulong* ranges, uint count)
+{
+    uint id = get_group_id(0);
+
+    if(id >= count)
+        return;
+
+    ulong source_offset = ranges[id * 3 + 0];
+    ulong dest_offset = ranges[id * 3 + 1];
+    ulong bytes = ranges[id * 3 + 2];
+
+    ulong lid = get_local_id(0);
+    ulong lsize = get_local_size(0);
+
+    if(((source_offset | dest_offset | bytes) & 15) == 0)
+    {
+        __global const uint4* source_wide = (__global const uint4*)(source + source_offset);
+        __global uint4* dest_wide = (__global uint4*)(dest + dest_offset);
+
+        for(ulong i = lid; i < bytes / 16; i += lsize)
+            dest_wide[i] = source_wide[i];
+
+        return;
+    }
+
+    for(ulong i = lid; i < bytes; i += lsize)
+        dest[dest_offset + i] = source[source_offset + i];
+}
+)";
+
+    ///reduce, compaction and sorting use the caller slots, scans use everything from SCAN_BASE upwards
+    ///copy_ranges has its own slot, so that its table can be uploaded asynchronously while a caller's slots are in use
+    enum scratch_slot
+    {
+        CALLER_0,
+        CALLER_1,
+        CALLER_2,
+        COPY_RANGES_TABLE,
+        SCAN_BASE,
+    };
+
+    std::mutex init_mut;
+    std::set<std::pair<cl_context, std::string>> initialised;
+
+    bool mark_initialised(cl::context& ctx, const std::string& name)
+    {
+        ///keyed on the native context, which a deferred context doesn't have until it's created
+        ctx.ensure_created();
+
+        std::scoped_lock lock(init_mut);
+
+        auto key = std::pair{ctx.native_context.data, name};
+
+        if(initialised.contains(key))
+            return false;
+
+        initialised.insert(key);
+        return true;
+    }
+
+    std::string radix_suffix(const cl::algo::type_info& key_info, int64_t value_size)
+    {
+        return key_info.name + "_" + (value_size == 8 ? "ulong" : "uint");
+    }
+
+    cl::event scan_recursive(cl::command_queue& cqueue, const cl::algo::type_info& inf, cl::buffer& in, cl::buffer& out, int64_t count, bool inclusive, cl::algo::scratch& s, int level, const std::vector<cl::event>& deps)
+    {
+        size_t wg = cl::algo::work_group_size;
+
+        int64_t blocks = (count + wg - 1) / wg;
+
+        cl::buffer sums = s.get(SCAN_BASE + level, blocks * inf.element_size);
+
+        cl::args block_args;
+        block_args.push_back(in);
+        block_args.push_back(out);
+        block_args.push_back(sums);
+        block_args.push_back((uint64_t)count);
+        block_args.push_back((int)inclusive);
+
+        cl::event evt = cqueue.exec("algo_scan_block_" + inf.name, block_args, {blocks * wg}, {wg}, deps);
+
+        if(blocks == 1)
+            return evt;
+
+        evt = scan_recursive(cqueue, inf, sums, sums, blocks, false, s, level + 1, {evt});
+
+        cl::args offset_args;
+        offset_args.push_back(out);
+        offset_args.push_back(sums);
+        offset_args.push_back((uint64_t)count);
+
+        return cqueue.exec("algo_scan_offset_" + inf.name, offset_args, {(size_t)count}, {wg}, {evt});
+    }
+}
+
+cl::algo::scratch::scratch(cl::context& _ctx) : ctx(_ctx)
+{
+
+}
+
+cl::buffer cl::algo::scratch::get(int slot, int64_t bytes)
+{
+    assert(slot >= 0);
+
+    while((int)slots.size() <= slot)
+    {
+        cl::buffer& added = slots.emplace_back(ctx);
+        added.memory_tag = "algo_scratch";
+    }
+
+    cl::buffer& buf = slots[slot];
+
+    if(buf.alloc_size < bytes)
+        buf.alloc(bytes);
+
+    return buf;
+}
+
+void cl::algo::init_impl(cl::context& ctx, const type_info& inf)
+{
+    if(!mark_initialised(ctx, inf.name))
+        return;
+
+    std::string options = "-DT=" + inf.name + " -DSUFFIX=" + inf.name + " -DWG=" + std::to_string(work_group_size) +
+                          " -DIDENT_MIN=" + inf.min_op_identity + " -DIDENT_MAX=" + inf.max_op_identity;
+
+    if(inf.subgroup_capable && cl::supports_extension(ctx, "cl_khr_subgroups"))
+        options += " -DALGO_SUBGROUPS -cl-std=CL2.0";
+
+    std::vector<std::string> produces =
+    {
+        "algo_reduce_" + inf.name,
+        "algo_scan_block_" + inf.name,
+        "algo_scan_offset_" + inf.name,
+        "algo_compact_" + inf.name,
+    };
+
+    cl::async_build_and_cache(ctx, []{return std::string(algo_source);}, produces, options);
+}
+
+cl::event cl::algo::reduce_impl(cl::command_queue& cqueue, const type_info& inf, cl::buffer& in, int64_t count, reduce_op::type op, cl::buffer& out, scratch& s, const std::vector<cl::event>& deps)
+{
+    assert(count * inf.element_size <= in.alloc_size);
+    assert(out.alloc_size >= inf.element_size);
+
+    size_t wg = work_group_size;
+
+    ///enough groups to fill the device, while keeping the second pass to a single group with a handful of elements per thread
+    int64_t groups = std::clamp<int64_t>((count + wg - 1) / wg, 1, wg * 4);
+
+    cl::buffer partials = s.get(CALLER_0, groups * inf.element_size);
+
+    cl::args first;
+    first.push_back(in);
+    first.push_back(partials);
+    first.push_back((uint64_t)count);
+    first.push_back((int)op);
+
+    cl::event evt = cqueue.exec("algo_reduce_" + inf.name, first, {groups * wg}, {wg}, deps);
+
+    cl::args second;
+    second.push_back(partials);
+    second.push_back(out);
+    second.push_back((uint64_t)groups);
+    second.push_back((int)op);
+
+    return cqueue.exec("algo_reduce_" + inf.name, second, {wg}, {wg}, {evt});
+}
+
+cl::event cl::algo::scan_impl(cl::command_queue& cqueue, const type_info& inf, cl::buffer& in, cl::buffer& out, int64_t count, bool inclusive, scratch& s, const std::vector<cl::event>& deps)
+{
+    assert(count * inf.element_size <= in.alloc_size);
+    assert(count * inf.element_size <= out.alloc_size);
+
+    if(count == 0)
+        return cl::event();
+
+    return scan_recursive(cqueue, inf, in, out, count, inclusive, s, 0, deps);
+}
+
+cl::event cl::algo::stream_compact_impl(cl::command_queue& cqueue, const type_info& inf, cl::buffer& in, cl::buffer& flags, int64_t count, cl::buffer& out, cl::buffer& out_count, scratch& s, const std::vector<cl::event>& deps)
+{
+    assert(count * inf.element_size <= in.alloc_size);
+    assert(count * inf.element_size <= out.alloc_size);
+    assert(count * (int64_t)sizeof(cl_uint) <= flags.alloc_size);
+    assert(out_count.alloc_size >= (int64_t)sizeof(cl_uint));
+
+    if(count == 0)
+    {
+        cl_uint zero = 0;
+
+        return out_count.fill(cqueue, &zero, sizeof(zero), sizeof(zero), deps);
+    }
+
+    cl::buffer positions = s.get(CALLER_0, count * sizeof(cl_uint));
+
+    cl::event scanned = scan_recursive(cqueue, get_type_info<uint32_t>(), flags, positions, count, false, s, 0, deps);
+
+    cl::args compact;
+    compact.push_back(in);
+    compact.push_back(flags);
+    compact.push_back(positions);
+    compact.push_back(out);
+    compact.push_back(out_count);
+    compact.push_back((uint64_t)count);
+
+    return cqueue.exec("algo_compact_" + inf.name, compact, {(size_t)count}, {(size_t)work_group_size}, {scanned});
+}
+
+void cl::algo::init_copy_ranges(cl::context& ctx)
+{
+    if(!mark_initialised(ctx, "copy_ranges"))
+        return;
+
+    cl::async_build_and_cache(ctx, []{return std::string(copy_source);}, {"algo_copy_ranges"}, "");
+}
+
+cl::event cl::algo::copy_ranges(cl::command_queue& cqueue, cl::buffer& source, cl::buffer& dest, const std::vector<copy_range>& ranges, scratch& s, const std::vector<cl::event>& deps)
+{
+    if(ranges.size() == 0)
+        return cqueue.enqueue_marker(deps);
+
+    if((int)ranges.size() < copy_ranges_kernel_threshold)
+    {
+        std::vector<cl::event> copies;
+
+        for(const copy_range& r : ranges)
+        {
+            if(r.bytes > 0)
+                copies.push_back(cl::copy(cqueue, source, r.source_offset, dest, r.dest_offset, r.bytes, deps));
+        }
+
+        return cqueue.enqueue_marker(copies);
+    }
+
+    assert(ranges.size() < (size_t)std::numeric_limits<cl_uint>::max());
+
+    init_copy_ranges(s.ctx);
+
+    std::vector<cl_ulong> table;
+    table.reserve(ranges.size() * 3);
+
+    int64_t largest = 0;
+
+    for(const copy_range& r : ranges)
+    {
+        assert(r.source_offset >= 0 && r.dest_offset >= 0 && r.bytes >= 0);
+        assert(r.source_offset + r.bytes <= source.alloc_size);
+        assert(r.dest_offset + r.bytes <= dest.alloc_size);
+
+        table.push_back(r.source_offset);
+        table.push_back(r.dest_offset);
+        table.push_back(r.bytes);
+
+        largest = std::max(largest, r.bytes);
+    }
+
+    cl::buffer range_buf = s.get(COPY_RANGES_TABLE, table.size() * sizeof(cl_ulong));
+
+    ///write_async copies the table. Overwriting the slot on the next call is ordered after this kernel by the queue,
+    ///or by the transfer route when the write is routed
+    std::vector<cl::event> exec_deps = deps;
+    exec_deps.push_back(range_buf.write_async(cqueue, (const char*)table.data(), table.size() * sizeof(cl_ulong)));
+
+    ///small ranges don't need a full work group each
+    size_t wg = std::clamp<size_t>(std::bit_ceil((size_t)std::max<int64_t>(largest / 16, 1)), 32, work_group_size);
+
+    cl::args args;
+    args.push_back(source);
+    args.push_back(dest);
+    args.push_back(range_buf);
+    args.push_back((cl_uint)ranges.size());
+
+    return cqueue.exec("algo_copy_ranges", args, {ranges.size() * wg}, {wg}, exec_deps);
+}
+
+void cl::algo::init_radix_sort_impl(cl::context& ctx, const type_info& key_info, int64_t value_size)
+{
+    assert(key_info.name == "uint" || key_info.name == "ulong");
+    assert(value_size == 4 || value_size == 8);
+
+    init<uint32_t>(ctx);
+
+    std::string suffix = radix_suffix(key_info, value_size);
+
+    if(!mark_initialised(ctx, "radix_" + suffix))
+        return;
+
+    std::string value_name = value_size == 8 ? "ulong" : "uint";
+
+    std::string options = "-DK=" + key_info.name + " -DV=" + value_name + " -DSUFFIX=" + suffix + " -DWG=" + std::to_string(work_group_size);
+
+    std::vector<std::string> produces =
+    {
+        "algo_radix_histogram_" + suffix,
+        "algo_radix_scatter_" + suffix,
+    };
+
+    cl::async_build_and_cache(ctx, []{return std::string(radix_source);}, produces, options);
+}
+
+cl::event cl::algo::radix_sort_impl(cl::command_queue& cqueue, const type_info& key_info, cl::buffer& keys, cl::buffer* values, int64_t value_size, int64_t count, int bits_per_pass, scratch& s, const std::vector<cl::event>& deps)
+{
+    assert(bits_per_pass >= 1 && bits_per_pass <= 8);
+    assert(count * key_info.element_size <= keys.alloc_size);
+    assert(values == nullptr || count * value_size <= values->alloc_size);
+    assert(count < (int64_t)std::numeric_limits<cl_uint>::max());
+
+    if(count <= 1)
+        return cqueue.enqueue_marker(deps);
+
+    std::string suffix = radix_suffix(key_info, value_size);
+
+    size_t wg = work_group_size;
+    int radix = 1 << bits_per_pass;
+    int passes = (key_info.element_size * 8 + bits_per_pass - 1) / bits_per_pass;
+
+    ///a few tiles per compute unit is enough to saturate the device, and keeps the histogram scan small
+    int64_t compute_units = s.ctx.get_caps().compute_units;
+    int64_t max_groups = std::max<int64_t>(compute_units * 8, 1);
+
+    int64_t groups = std::min<int64_t>((count + wg - 1) / wg, max_groups);
+    int64_t tile = (count + groups - 1) / groups;
+    tile = ((tile + wg - 1) / wg) * wg;
+    groups = (count + tile - 1) / tile;
+
+    cl::buffer temp_keys = s.get(CALLER_0, count * key_info.element_size);
+    cl::buffer hist = s.get(CALLER_2, radix * groups * sizeof(cl_uint));
+
+    std::optional<cl::buffer> temp_values;
+
+    if(values)
+        temp_values = s.get(CALLER_1, count * value_size);
+
+    cl::buffer* key_bufs[2] = {&keys, &temp_keys};
+    cl::buffer* value_bufs[2] = {values, temp_values.has_value() ? &temp_values.value() : nullptr};
+
+    std::vector<cl::event> last = deps;
+
+    for(int pass = 0; pass < passes; pass++)
+    {
+        cl::buffer& keys_in = *key_bufs[pass % 2];
+        cl::buffer& keys_out = *key_bufs[(pass + 1) % 2];
+
+        cl_uint shift = pass * bits_per_pass;
+
+        cl::args histogram;
+        histogram.push_back(keys_in);
+        histogram.push_back(hist);
+        histogram.push_back((uint64_t)count);
+        histogram.push_back((uint64_t)tile);
+        histogram.push_back(shift);
+        histogram.push_back((cl_uint)radix);
+        histogram.push_back((cl_uint)groups);
+
+        cl::event counted = cqueue.exec("algo_radix_histogram_" + suffix, histogram, {groups * wg}, {wg}, last);
+
+        cl::event offsets = scan_recursive(cqueue, get_type_info<uint32_t>(), hist, hist, radix * groups, false, s, 0, {counted});
+
+        cl::args scatter;
+        scatter.push_back(keys_in);
+        scatter.push_back(keys_out);
+
+        if(values)
+        {
+            scatter.push_back(*value_bufs[pass % 2]);
+            scatter.push_back(*value_bufs[(pass + 1) % 2]);
+        }
+        else
+        {
+            scatter.push_back(nullptr);
+            scatter.push_back(nullptr);
+        }
+
+        scatter.push_back(hist);
+        scatter.push_back((uint64_t)count);
+        scatter.push_back((uint64_t)tile);
+        scatter.push_back(shift);
+        scatter.push_back((cl_uint)bits_per_pass);
+        scatter.push_back((cl_uint)groups);
+        scatter.push_back((int)(values != nullptr));
+
+        last = {cqueue.exec("algo_radix_scatter_" + suffix, scatter, {groups * wg}, {wg}, {offsets})};
+    }
+
+    ///an odd number of passes leaves the result in the temporaries
+    if((passes % 2) == 1)
+    {
+        cl::event copied_keys = cl::copy(cqueue, temp_keys, 0, keys, 0, count * key_info.element_size, last);
+
+        if(values)
+        {
+            cl::event copied_values = cl::copy(cqueue, temp_values.value(), 0, *values, 0, count * value_size, last);
+
+            return cqueue.enqueue_marker({copied_keys, copied_values});
+        }
+
+        return copied_keys;
+    }
+
+    return last.at(0);
+}
+
+#endif // NO_OPENCL
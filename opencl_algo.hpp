@@ -0,0 +1,172 @@
+#ifndef OPENCL_ALGO_HPP_INCLUDED
+#define OPENCL_ALGO_HPP_INCLUDED
+
+#include "opencl.hpp"
+#include <string>
+#include <vector>
+
+///device side parallel primitives. Kernels are built from embedded source and registered into the context
+///like any other program, once per element type via init<T>
+namespace cl
+{
+    namespace algo
+    {
+        static constexpr int work_group_size = 256;
+
+        namespace reduce_op
+        {
+            enum type
+            {
+                ADD,
+                MIN,
+                MAX,
+            };
+        }
+
+        ///reusable device side temporaries, grown on demand and never shrunk
+        struct scratch
+        {
+            cl::context ctx;
+            std::vector<cl::buffer> slots;
+
+            scratch(cl::context& ctx);
+
+            ///returns a copy of the handle, so that growing the slot list doesn't invalidate it
+            cl::buffer get(int slot, int64_t bytes);
+        };
+
+        struct type_info
+        {
+            std::string name;
+            ///the identity element for min is the largest value of the type, and vice versa
+            std::string min_op_identity;
+            std::string max_op_identity;
+            int64_t element_size = 0;
+            bool subgroup_capable = false;
+        };
+
+        template<typename T>
+        inline
+        type_info get_type_info()
+        {
+            #define ALGO_TYPE(real_type, cl_name, lowest, highest) \
+            if constexpr(std::is_same_v<T, real_type>) \
+                return type_info{cl_name, highest, lowest, sizeof(real_type), sizeof(real_type) >= 4};
+
+            ALGO_TYPE(int64_t, "long", "LONG_MIN", "LONG_MAX");
+            ALGO_TYPE(uint64_t, "ulong", "0", "ULONG_MAX");
+            ALGO_TYPE(int32_t, "int", "INT_MIN", "INT_MAX");
+            ALGO_TYPE(uint32_t, "uint", "0", "UINT_MAX");
+            ALGO_TYPE(int16_t, "short", "SHRT_MIN", "SHRT_MAX");
+            ALGO_TYPE(uint16_t, "ushort", "0", "USHRT_MAX");
+            ALGO_TYPE(int8_t, "char", "CHAR_MIN", "CHAR_MAX");
+            ALGO_TYPE(uint8_t, "uchar", "0", "UCHAR_MAX");
+            ALGO_TYPE(double, "double", "-INFINITY", "INFINITY");
+            ALGO_TYPE(float, "float", "-INFINITY", "INFINITY");
+            ALGO_TYPE(cl_float16_impl, "half", "-INFINITY", "INFINITY");
+
+            #undef ALGO_TYPE
+
+            assert(false);
+            return type_info();
+        }
+
+        void init_impl(cl::context& ctx, const type_info& inf);
+
+        cl::event reduce_impl(cl::command_queue& cqueue, const type_info& inf, cl::buffer& in, int64_t count, reduce_op::type op, cl::buffer& out, scratch& s, const std::vector<cl::event>& deps);
+        cl::event scan_impl(cl::command_queue& cqueue, const type_info& inf, cl::buffer& in, cl::buffer& out, int64_t count, bool inclusive, scratch& s, const std::vector<cl::event>& deps);
+        cl::event stream_compact_impl(cl::command_queue& cqueue, const type_info& inf, cl::buffer& in, cl::buffer& flags, int64_t count, cl::buffer& out, cl::buffer& out_count, scratch& s, const std::vector<cl::event>& deps);
+
+        struct copy_range
+        {
+            int64_t source_offset = 0;
+            int64_t dest_offset = 0;
+            int64_t bytes = 0;
+        };
+
+        ///below this many ranges, copy_ranges enqueues one copy per range instead of a kernel
+        static constexpr int copy_ranges_kernel_threshold = 32;
+
+        void init_copy_ranges(cl::context& ctx);
+
+        ///many independent moves from source to dest, which may be the same buffer if no destination range overlaps a source range
+        ///large batches are done as one gather/scatter kernel, with a work group per range. Builds its kernel on first use if init_copy_ranges hasn't been called
+        cl::event copy_ranges(cl::command_queue& cqueue, cl::buffer& source, cl::buffer& dest, const std::vector<copy_range>& ranges, scratch& s, const std::vector<cl::event>& deps = {});
+
+        void init_radix_sort_impl(cl::context& ctx, const type_info& key_info, int64_t value_size);
+        cl::event radix_sort_impl(cl::command_queue& cqueue, const type_info& key_info, cl::buffer& keys, cl::buffer* values, int64_t value_size, int64_t count, int bits_per_pass, scratch& s, const std::vector<cl::event>& deps);
+
+        ///builds asynchronously, kernels are waited on the first time they're executed. Safe to call more than once
+        template<typename T>
+        inline
+        void init(cl::context& ctx)
+        {
+            init_impl(ctx, get_type_info<T>());
+        }
+
+        ///writes a single T to out
+        template<typename T>
+        inline
+        cl::event reduce(cl::command_queue& cqueue, cl::buffer& in, int64_t count, reduce_op::type op, cl::buffer& out, scratch& s, const std::vector<cl::event>& deps = {})
+        {
+            return reduce_impl(cqueue, get_type_info<T>(), in, count, op, out, s, deps);
+        }
+
+        ///in and out may be the same buffer
+        template<typename T>
+        inline
+        cl::event inclusive_scan(cl::command_queue& cqueue, cl::buffer& in, cl::buffer& out, int64_t count, scratch& s, const std::vector<cl::event>& deps = {})
+        {
+            return scan_impl(cqueue, get_type_info<T>(), in, out, count, true, s, deps);
+        }
+
+        template<typename T>
+        inline
+        cl::event exclusive_scan(cl::command_queue& cqueue, cl::buffer& in, cl::buffer& out, int64_t count, scratch& s, const std::vector<cl::event>& deps = {})
+        {
+            return scan_impl(cqueue, get_type_info<T>(), in, out, count, false, s, deps);
+        }
+
+        ///flags is a buffer of cl_uint which must be 0 or 1. Kept elements are written densely to out in their original order,
+        ///and the number kept is written to out_count as a single cl_uint. Requires init<uint32_t> as well as init<T>
+        template<typename T>
+        inline
+        cl::event stream_compact(cl::command_queue& cqueue, cl::buffer& in, cl::buffer& flags, int64_t count, cl::buffer& out, cl::buffer& out_count, scratch& s, const std::vector<cl::event>& deps = {})
+        {
+            return stream_compact_impl(cqueue, get_type_info<T>(), in, flags, count, out, out_count, s, deps);
+        }
+
+        ///keys are uint32_t or uint64_t. Values are an opaque 4 or 8 byte payload which is permuted alongside the keys
+        template<typename K, typename V = uint32_t>
+        inline
+        void init_radix_sort(cl::context& ctx)
+        {
+            static_assert(std::is_same_v<K, uint32_t> || std::is_same_v<K, uint64_t>);
+            static_assert(sizeof(V) == 4 || sizeof(V) == 8);
+
+            init_radix_sort_impl(ctx, get_type_info<K>(), sizeof(V));
+        }
+
+        ///stable least significant digit sort, in place. bits_per_pass is between 1 and 8, and trades passes for local work
+        template<typename K>
+        inline
+        cl::event radix_sort(cl::command_queue& cqueue, cl::buffer& keys, int64_t count, scratch& s, int bits_per_pass = 4, const std::vector<cl::event>& deps = {})
+        {
+            static_assert(std::is_same_v<K, uint32_t> || std::is_same_v<K, uint64_t>);
+
+            return radix_sort_impl(cqueue, get_type_info<K>(), keys, nullptr, sizeof(uint32_t), count, bits_per_pass, s, deps);
+        }
+
+        template<typename K, typename V>
+        inline
+        cl::event radix_sort_by_key(cl::command_queue& cqueue, cl::buffer& keys, cl::buffer& values, int64_t count, scratch& s, int bits_per_pass = 4, const std::vector<cl::event>& deps = {})
+        {
+            static_assert(std::is_same_v<K, uint32_t> || std::is_same_v<K, uint64_t>);
+            static_assert(sizeof(V) == 4 || sizeof(V) == 8);
+
+            return radix_sort_impl(cqueue, get_type_info<K>(), keys, &values, sizeof(V), count, bits_per_pass, s, deps);
+        }
+    }
+}
+
+#endif // OPENCL_ALGO_HPP_INCLUDED
@@ -0,0 +1,262 @@
+#include "config.hpp"
+
+#ifndef NO_OPENCL
+
+#include "opencl_reload.hpp"
+#include <iostream>
+#include <set>
+#include <chrono>
+#include <utility>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr int inotify_poll_ms = 100;
+    constexpr int fallback_poll_ms = 250;
+    ///editors often save in several steps, so let them settle before rebuilding
+    constexpr int debounce_ms = 100;
+
+    std::string normalise(const std::string& path)
+    {
+        return std::filesystem::path(path).lexically_normal().generic_string();
+    }
+
+    ///files which are missing right now are left out, eg mid save
+    std::map<std::string, std::filesystem::file_time_type> stat_sources(const std::vector<std::string>& files, const std::string& options)
+    {
+        std::vector<std::string> all = files;
+
+        for(const std::string& dep : cl::get_include_dependencies(files, true, options))
+            all.push_back(dep);
+
+        std::map<std::string, std::filesystem::file_time_type> ret;
+
+        for(const std::string& path : all)
+        {
+            std::error_code ec;
+            auto mtime = std::filesystem::last_write_time(path, ec);
+
+            if(!ec)
+                ret[normalise(path)] = mtime;
+        }
+
+        return ret;
+    }
+
+    std::vector<std::string> get_kernel_names(cl::program& prog)
+    {
+        std::vector<std::string> ret;
+
+        for(auto& [name, kern] : prog.async->built_kernels)
+            ret.push_back(name);
+
+        return ret;
+    }
+
+    bool has_changed(const cl::kernel_watcher::watched_program& prog)
+    {
+        for(const auto& [path, mtime] : prog.sources)
+        {
+            std::error_code ec;
+            auto current = std::filesystem::last_write_time(path, ec);
+
+            if(!ec && current != mtime)
+                return true;
+        }
+
+        return false;
+    }
+
+    ///the single place rebuild failures are reported, printed and queued for consume_errors. Requires st.mut
+    void push_error_locked(cl::kernel_watcher::state& st, const std::string& message)
+    {
+        std::cout << message << std::endl;
+
+        st.errors.push_back(message);
+    }
+
+    ///builds happen without holding the lock, so that add_program and consume_errors never wait on the compiler
+    void rebuild_changed(cl::kernel_watcher::state& st)
+    {
+        std::vector<std::pair<int, cl::kernel_watcher::watched_program>> dirty;
+
+        {
+            std::scoped_lock guard(st.mut);
+
+            for(int i=0; i < (int)st.programs.size(); i++)
+            {
+                if(has_changed(st.programs[i]))
+                    dirty.push_back({i, st.programs[i]});
+            }
+        }
+
+        for(auto& [idx, prog] : dirty)
+        {
+            std::string name;
+
+            for(const std::string& file : prog.files)
+                name += (name.size() > 0 ? " " : "") + file;
+
+            ///taken before building, so that a file saved while the compiler runs is still seen as changed afterwards
+            auto sources = stat_sources(prog.files, prog.options);
+
+            try
+            {
+                cl::program built = cl::build_program_with_cache(st.ctx, prog.files, true, prog.options);
+                built.ensure_built();
+
+                st.ctx.replace_program(prog.kernel_names, built);
+
+                std::vector<std::string> names = get_kernel_names(built);
+
+                std::scoped_lock guard(st.mut);
+
+                st.programs[idx].kernel_names = names;
+                st.programs[idx].sources = sources;
+                st.reloads++;
+
+                std::cout << "Reloaded " << name << std::endl;
+            }
+            catch(std::exception& e)
+            {
+                std::scoped_lock guard(st.mut);
+
+                push_error_locked(st, "Failed to reload " + name + ": " + e.what());
+
+                ///don't retry until the files change again
+                st.programs[idx].sources = sources;
+            }
+        }
+    }
+
+    void poll_loop(std::shared_ptr<cl::kernel_watcher::state> st)
+    {
+        while(!st->stopping)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(fallback_poll_ms));
+
+            rebuild_changed(*st);
+        }
+    }
+
+    void watch_loop(std::shared_ptr<cl::kernel_watcher::state> st)
+    {
+        #ifdef __linux__
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+        if(fd < 0)
+        {
+            std::cout << "inotify unavailable, polling kernel sources instead" << std::endl;
+
+            return poll_loop(st);
+        }
+
+        std::set<std::string> watched_dirs;
+
+        auto drain = [&]()
+        {
+            alignas(inotify_event) char buf[4096];
+
+            while(read(fd, buf, sizeof(buf)) > 0){}
+        };
+
+        while(!st->stopping)
+        {
+            ///directories rather than files, as editors commonly save by writing a new file and renaming it over the old one
+            {
+                std::scoped_lock guard(st->mut);
+
+                for(const auto& prog : st->programs)
+                {
+                    for(const auto& [path, mtime] : prog.sources)
+                    {
+                        std::string dir = std::filesystem::path(path).parent_path().generic_string();
+
+                        if(dir == "")
+                            dir = ".";
+
+                        if(watched_dirs.contains(dir))
+                            continue;
+
+                        if(inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE) >= 0)
+                            watched_dirs.insert(dir);
+                    }
+                }
+            }
+
+            pollfd pfd = {fd, POLLIN, 0};
+
+            if(poll(&pfd, 1, inotify_poll_ms) <= 0)
+                continue;
+
+            drain();
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(debounce_ms));
+
+            drain();
+
+            ///events anywhere in a watched directory just trigger a modification time check
+            rebuild_changed(*st);
+        }
+
+        close(fd);
+        #else
+        poll_loop(st);
+        #endif
+    }
+}
+
+cl::kernel_watcher::kernel_watcher(cl::context& ctx)
+{
+    ///builds take a const context, which must already have been created if it was deferred
+    ctx.ensure_created();
+
+    data = std::make_shared<state>(ctx);
+
+    worker = std::thread(watch_loop, data);
+}
+
+cl::kernel_watcher::~kernel_watcher()
+{
+    data->stopping = true;
+
+    worker.join();
+}
+
+void cl::kernel_watcher::add_program(const std::vector<std::string>& files, const std::string& options)
+{
+    auto sources = stat_sources(files, options);
+
+    cl::program prog = cl::build_program_with_cache(data->ctx, files, true, options);
+
+    data->ctx.register_program(prog);
+
+    watched_program watched;
+    watched.files = files;
+    watched.options = options;
+    watched.kernel_names = get_kernel_names(prog);
+    watched.sources = std::move(sources);
+
+    std::scoped_lock guard(data->mut);
+
+    data->programs.push_back(std::move(watched));
+}
+
+std::vector<std::string> cl::kernel_watcher::consume_errors()
+{
+    std::scoped_lock guard(data->mut);
+
+    return std::exchange(data->errors, {});
+}
+
+int cl::kernel_watcher::get_reload_count()
+{
+    return data->reloads;
+}
+
+#endif // NO_OPENCL
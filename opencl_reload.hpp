@@ -0,0 +1,55 @@
+#ifndef OPENCL_RELOAD_HPP_INCLUDED
+#define OPENCL_RELOAD_HPP_INCLUDED
+
+#include "opencl.hpp"
+#include <thread>
+#include <filesystem>
+
+///hot reload of kernel sources. Programs are rebuilt on a background thread when their files, or anything they #include, change
+///and the new kernels are swapped into the context in one step. Uses inotify on linux, and polls modification times elsewhere
+namespace cl
+{
+    struct kernel_watcher
+    {
+        struct watched_program
+        {
+            std::vector<std::string> files;
+            std::string options;
+            std::vector<std::string> kernel_names;
+            ///files plus everything they include, with the modification time seen at the last build
+            std::map<std::string, std::filesystem::file_time_type> sources;
+        };
+
+        struct state
+        {
+            cl::context ctx;
+            std::mutex mut;
+            std::vector<watched_program> programs;
+            std::vector<std::string> errors;
+            std::atomic_bool stopping{false};
+            std::atomic_int reloads{0};
+
+            state(cl::context& in) : ctx(in){}
+        };
+
+        std::shared_ptr<state> data;
+        std::thread worker;
+
+        kernel_watcher(cl::context& ctx);
+        ~kernel_watcher();
+
+        kernel_watcher(const kernel_watcher&) = delete;
+        kernel_watcher& operator=(const kernel_watcher&) = delete;
+
+        ///builds with build_program_with_cache and registers the program, then watches it. The initial build throws on failure
+        void add_program(const std::vector<std::string>& files, const std::string& options = "");
+
+        ///the build logs of failed rebuilds since the last call. A failed rebuild leaves the previous kernels registered
+        std::vector<std::string> consume_errors();
+
+        ///the number of successful swaps so far
+        int get_reload_count();
+    };
+}
+
+#endif // OPENCL_RELOAD_HPP_INCLUDED
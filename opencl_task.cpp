@@ -0,0 +1,161 @@
+#include "config.hpp"
+
+#ifndef NO_OPENCL
+
+#include "opencl_task.hpp"
+#include <stdexcept>
+#include <string>
+
+cl::executor::executor(int thread_count)
+{
+    thread_count = std::max(thread_count, 1);
+
+    for(int i=0; i < thread_count; i++)
+    {
+        threads.emplace_back([this]()
+        {
+            while(1)
+            {
+                std::function<void()> func;
+
+                {
+                    std::unique_lock guard(mut);
+
+                    cv.wait(guard, [&]{return stopping || pending.size() > 0;});
+
+                    if(pending.size() == 0)
+                        return;
+
+                    func = std::move(pending.front());
+                    pending.pop_front();
+                }
+
+                func();
+            }
+        });
+    }
+}
+
+cl::executor::~executor()
+{
+    {
+        std::scoped_lock guard(mut);
+        stopping = true;
+    }
+
+    cv.notify_all();
+
+    for(std::thread& t : threads)
+        t.join();
+}
+
+void cl::executor::post(std::function<void()> func)
+{
+    {
+        std::scoped_lock guard(mut);
+        pending.push_back(std::move(func));
+    }
+
+    cv.notify_one();
+}
+
+cl::executor& cl::executor::get_default()
+{
+    static executor exec(1);
+
+    return exec;
+}
+
+namespace
+{
+    ///shared between every event's completion callback. The last callback to fire owns resuming the coroutine
+    struct await_state
+    {
+        std::atomic_int remaining{0};
+        std::atomic_int status{CL_COMPLETE};
+        std::coroutine_handle<> handle;
+        cl::executor* exec = nullptr;
+        cl_int* status_out = nullptr;
+    };
+
+    void CL_CALLBACK on_event_complete(cl_event evt, cl_int event_command_status, void* user_data)
+    {
+        await_state* state = (await_state*)user_data;
+
+        if(event_command_status < 0)
+            state->status = event_command_status;
+
+        if(state->remaining.fetch_sub(1) != 1)
+            return;
+
+        *state->status_out = state->status;
+
+        std::coroutine_handle<> handle = state->handle;
+        state->exec->post([handle](){handle.resume();});
+
+        delete state;
+    }
+}
+
+bool cl::events_awaiter::await_ready()
+{
+    for(event& e : events)
+    {
+        if(!e.is_finished())
+            return false;
+    }
+
+    return true;
+}
+
+void cl::events_awaiter::await_suspend(std::coroutine_handle<> handle)
+{
+    std::vector<event> live;
+
+    for(event& e : events)
+    {
+        if(e.native_event.data != nullptr)
+            live.push_back(e);
+    }
+
+    if(live.size() == 0)
+    {
+        exec->post([handle](){handle.resume();});
+        return;
+    }
+
+    await_state* state = new await_state;
+    state->remaining = live.size();
+    state->handle = handle;
+    state->exec = exec;
+    state->status_out = &status;
+
+    ///callbacks may fire immediately on other threads, so nothing may touch this or state after the loop starts
+    for(event& e : live)
+    {
+        e.set_completion_callback(on_event_complete, state);
+    }
+}
+
+void cl::events_awaiter::await_resume()
+{
+    if(status < 0)
+        throw std::runtime_error("Awaited event completed with error " + std::to_string(status));
+
+    ///await_ready skips suspending when every event is finished, but that doesn't distinguish errors
+    for(event& e : events)
+    {
+        if(e.native_event.data == nullptr)
+            continue;
+
+        cl_int event_status = CL_COMPLETE;
+
+        if(clGetEventInfo(e.native_event.data, CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(cl_int), (void*)&event_status, nullptr) != CL_SUCCESS)
+            throw std::runtime_error("Bad event in clGetEventInfo in await_resume");
+
+        if(event_status < 0)
+            throw std::runtime_error("Awaited event completed with error " + std::to_string(event_status));
+    }
+}
+
+#endif // NO_OPENCL
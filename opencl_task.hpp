@@ -0,0 +1,251 @@
+#ifndef OPENCL_TASK_HPP_INCLUDED
+#define OPENCL_TASK_HPP_INCLUDED
+
+#include "opencl.hpp"
+#include <coroutine>
+#include <exception>
+#include <deque>
+#include <thread>
+#include <condition_variable>
+#include <utility>
+
+///coroutine support for cl::event. co_await on an event suspends until it completes, and resumes on an executor
+///rather than on the driver's callback thread, which must never block
+namespace cl
+{
+    struct executor
+    {
+        executor(int thread_count = 1);
+        ~executor();
+
+        executor(const executor&) = delete;
+        executor& operator=(const executor&) = delete;
+
+        void post(std::function<void()> func);
+
+        ///lazily created, shared by every co_await which doesn't name an executor
+        static executor& get_default();
+
+    private:
+        std::mutex mut;
+        std::condition_variable cv;
+        std::deque<std::function<void()>> pending;
+        bool stopping = false;
+        std::vector<std::thread> threads;
+    };
+
+    ///awaits every event. Throws from co_await if any of them completed with an error status
+    struct events_awaiter
+    {
+        std::vector<event> events;
+        executor* exec = nullptr;
+        cl_int status = CL_COMPLETE;
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> handle);
+        void await_resume();
+    };
+
+    inline
+    events_awaiter operator co_await(const event& evt)
+    {
+        return events_awaiter{{evt}, &executor::get_default()};
+    }
+
+    inline
+    events_awaiter resume_on(executor& exec, const event& evt)
+    {
+        return events_awaiter{{evt}, &exec};
+    }
+
+    inline
+    events_awaiter when_all(std::vector<event> events, executor& exec = executor::get_default())
+    {
+        return events_awaiter{std::move(events), &exec};
+    }
+
+    template<typename... T>
+    inline
+    events_awaiter when_all(const event& first, const T&... rest)
+    {
+        return events_awaiter{{first, rest...}, &executor::get_default()};
+    }
+
+    template<typename T>
+    struct task;
+
+    namespace detail
+    {
+        struct task_promise_base
+        {
+            std::coroutine_handle<> continuation;
+            std::exception_ptr exception;
+            ///owned jointly with block(), as the frame may be destroyed as soon as block() sees it set
+            std::shared_ptr<std::atomic_bool> finished;
+
+            struct final_awaiter
+            {
+                bool await_ready() noexcept {return false;}
+
+                template<typename P>
+                std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) noexcept
+                {
+                    task_promise_base& promise = handle.promise();
+
+                    ///read before publishing finished, as a blocked owner may destroy the frame straight after
+                    std::coroutine_handle<> next = promise.continuation;
+
+                    if(next)
+                        return next;
+
+                    std::shared_ptr<std::atomic_bool> finished = promise.finished;
+
+                    if(finished)
+                    {
+                        *finished = true;
+                        finished->notify_all();
+                    }
+
+                    return std::noop_coroutine();
+                }
+
+                void await_resume() noexcept {}
+            };
+
+            std::suspend_always initial_suspend() noexcept {return {};}
+            final_awaiter final_suspend() noexcept {return {};}
+
+            void unhandled_exception() {exception = std::current_exception();}
+        };
+
+        template<typename T>
+        struct task_promise : task_promise_base
+        {
+            std::optional<T> value;
+
+            task<T> get_return_object();
+
+            template<typename U>
+            void return_value(U&& in) {value.emplace(std::forward<U>(in));}
+
+            T take()
+            {
+                if(exception)
+                    std::rethrow_exception(exception);
+
+                return std::move(*value);
+            }
+        };
+
+        template<>
+        struct task_promise<void> : task_promise_base
+        {
+            task<void> get_return_object();
+
+            void return_void() {}
+
+            void take()
+            {
+                if(exception)
+                    std::rethrow_exception(exception);
+            }
+        };
+    }
+
+    ///lazily started: runs when co_awaited from another coroutine, or when block() is called
+    template<typename T = void>
+    struct task
+    {
+        using promise_type = detail::task_promise<T>;
+
+        std::coroutine_handle<promise_type> handle;
+
+        task(){}
+        explicit task(std::coroutine_handle<promise_type> in) : handle(in){}
+
+        task(task&& other) : handle(std::exchange(other.handle, nullptr)){}
+
+        task& operator=(task&& other)
+        {
+            if(this != &other)
+            {
+                if(handle)
+                    handle.destroy();
+
+                handle = std::exchange(other.handle, nullptr);
+            }
+
+            return *this;
+        }
+
+        ~task()
+        {
+            if(handle)
+                handle.destroy();
+        }
+
+        struct awaiter
+        {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() {return false;}
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller)
+            {
+                handle.promise().continuation = caller;
+                return handle;
+            }
+
+            T await_resume()
+            {
+                return handle.promise().take();
+            }
+        };
+
+        awaiter operator co_await() &&
+        {
+            assert(handle);
+
+            return awaiter{handle};
+        }
+
+        awaiter operator co_await() &
+        {
+            assert(handle);
+
+            return awaiter{handle};
+        }
+
+        ///starts the task on this thread, and waits for it to finish wherever it ends up being resumed
+        T block()
+        {
+            assert(handle);
+
+            promise_type& promise = handle.promise();
+
+            std::shared_ptr<std::atomic_bool> finished = std::make_shared<std::atomic_bool>(false);
+            promise.finished = finished;
+
+            handle.resume();
+
+            finished->wait(false);
+
+            return promise.take();
+        }
+    };
+
+    template<typename T>
+    inline
+    task<T> detail::task_promise<T>::get_return_object()
+    {
+        return task<T>{std::coroutine_handle<task_promise<T>>::from_promise(*this)};
+    }
+
+    inline
+    task<void> detail::task_promise<void>::get_return_object()
+    {
+        return task<void>{std::coroutine_handle<task_promise<void>>::from_promise(*this)};
+    }
+}
+
+#endif // OPENCL_TASK_HPP_INCLUDED
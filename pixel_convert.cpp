@@ -0,0 +1,532 @@
+#include "pixel_convert.hpp"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <array>
+
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)) && !defined(__EMSCRIPTEN__)
+#define PIXEL_X86
+#include <immintrin.h>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TARGET_AVX2
+#define TARGET_F16C
+#define TARGET_SSE2
+#else
+#include <cpuid.h>
+#define TARGET_AVX2 __attribute__((target("avx2,f16c")))
+///f16c only needs avx's ymm registers, and ships on cpus without avx2
+#define TARGET_F16C __attribute__((target("avx,f16c")))
+#define TARGET_SSE2 __attribute__((target("sse2")))
+#endif // _MSC_VER
+#endif // PIXEL_X86
+
+namespace
+{
+    #ifdef PIXEL_X86
+    struct cpu_features
+    {
+        bool sse2 = false;
+        bool avx2 = false;
+        bool f16c = false;
+    };
+
+    cpu_features detect_features()
+    {
+        cpu_features ret;
+
+        unsigned int leaf1[4] = {};
+        unsigned int leaf7[4] = {};
+
+        #ifdef _MSC_VER
+        int regs[4] = {};
+        __cpuid(regs, 1);
+
+        for(int i=0; i < 4; i++)
+            leaf1[i] = regs[i];
+
+        __cpuidex(regs, 7, 0);
+
+        for(int i=0; i < 4; i++)
+            leaf7[i] = regs[i];
+        #else
+        __get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+        __get_cpuid_count(7, 0, &leaf7[0], &leaf7[1], &leaf7[2], &leaf7[3]);
+        #endif // _MSC_VER
+
+        bool osxsave = (leaf1[2] >> 27) & 1;
+        bool avx = (leaf1[2] >> 28) & 1;
+
+        ///the os has to save the upper halves of the ymm registers for avx to be usable
+        bool ymm_enabled = false;
+
+        if(osxsave && avx)
+        {
+            #ifdef _MSC_VER
+            unsigned long long xcr0 = _xgetbv(0);
+            #else
+            unsigned int eax = 0, edx = 0;
+            __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+            unsigned long long xcr0 = ((unsigned long long)edx << 32) | eax;
+            #endif // _MSC_VER
+
+            ymm_enabled = (xcr0 & 6) == 6;
+        }
+
+        ret.sse2 = (leaf1[3] >> 26) & 1;
+        ret.f16c = ymm_enabled && ((leaf1[2] >> 29) & 1);
+        ret.avx2 = ymm_enabled && ((leaf7[1] >> 5) & 1);
+
+        return ret;
+    }
+
+    const cpu_features& features()
+    {
+        static cpu_features feat = detect_features();
+
+        return feat;
+    }
+    #endif // PIXEL_X86
+
+    uint32_t as_bits(float in)
+    {
+        uint32_t ret;
+        memcpy(&ret, &in, sizeof(ret));
+        return ret;
+    }
+
+    float as_float(uint32_t in)
+    {
+        float ret;
+        memcpy(&ret, &in, sizeof(ret));
+        return ret;
+    }
+
+    uint16_t float_to_half_scalar(float in)
+    {
+        uint32_t bits = as_bits(in);
+        uint32_t sign = (bits >> 16) & 0x8000;
+        uint32_t mag = bits & 0x7fffffff;
+
+        ///too large for a half, or inf or nan
+        if(mag >= 0x47800000)
+            return sign | (mag > 0x7f800000 ? 0x7e00 : 0x7c00);
+
+        ///below the smallest normal half. Adding 0.5 lines the mantissa up so that the fpu does the rounding
+        if(mag < 0x38800000)
+        {
+            uint32_t rounded = as_bits(as_float(mag) + 0.5f);
+
+            return sign | (rounded - 0x3f000000);
+        }
+
+        uint32_t mantissa_odd = (mag >> 13) & 1;
+
+        ///rebias the exponent, and round to nearest even
+        mag += (uint32_t)(15 - 127) << 23;
+        mag += 0xfff + mantissa_odd;
+
+        return sign | (mag >> 13);
+    }
+
+    float half_to_float_scalar(uint16_t in)
+    {
+        uint32_t sign = (uint32_t)(in & 0x8000) << 16;
+        uint32_t exponent = (in >> 10) & 0x1f;
+        uint32_t mantissa = in & 0x3ff;
+
+        if(exponent == 0)
+            return as_float(sign | as_bits(mantissa * (1.f / 16777216.f)));
+
+        if(exponent == 31)
+            return as_float(sign | 0x7f800000 | (mantissa << 13));
+
+        return as_float(sign | ((exponent + 112) << 23) | (mantissa << 13));
+    }
+
+    float srgb_to_linear_exact(float in)
+    {
+        if(in <= 0.04045f)
+            return in / 12.92f;
+
+        return powf((in + 0.055f) / 1.055f, 2.4f);
+    }
+
+    float linear_to_srgb_exact(float in)
+    {
+        if(in <= 0.0031308f)
+            return in * 12.92f;
+
+        return 1.055f * powf(in, 1/2.4f) - 0.055f;
+    }
+
+    ///piecewise linear tables over [2^-13, 1], indexed by exponent and the top mantissa bits. Both curves are linear below 2^-13
+    constexpr int table_mantissa_bits = 7;
+    constexpr int table_min_exponent = 127 - 13;
+    constexpr int table_shift = 23 - table_mantissa_bits;
+    constexpr int table_size = (13 << table_mantissa_bits) + 2;
+    constexpr float table_min_value = 1.f / 8192.f;
+
+    struct curve_table
+    {
+        std::array<float, table_size> values;
+        ///the slope of the linear segment near zero
+        float linear_scale = 1;
+
+        template<typename T>
+        curve_table(T func, float _linear_scale)
+        {
+            linear_scale = _linear_scale;
+
+            for(int i=0; i < table_size; i++)
+            {
+                float start = as_float((uint32_t)(i + (table_min_exponent << table_mantissa_bits)) << table_shift);
+
+                values[i] = func(std::min(start, 1.f));
+            }
+        }
+    };
+
+    const curve_table& srgb_to_linear_table()
+    {
+        static curve_table table(srgb_to_linear_exact, 1/12.92f);
+
+        return table;
+    }
+
+    const curve_table& linear_to_srgb_table()
+    {
+        static curve_table table(linear_to_srgb_exact, 12.92f);
+
+        return table;
+    }
+
+    const std::array<float, 256>& srgb8_to_linear_table()
+    {
+        static std::array<float, 256> table = []()
+        {
+            std::array<float, 256> ret;
+
+            for(int i=0; i < 256; i++)
+                ret[i] = srgb_to_linear_exact(i / 255.f);
+
+            return ret;
+        }();
+
+        return table;
+    }
+
+    float apply_table_scalar(float in, const curve_table& table)
+    {
+        ///written so that nans clamp to 0
+        float x = std::min(std::max(in, 0.f), 1.f);
+
+        if(!(x >= table_min_value))
+            return (x >= 0 ? x : 0) * table.linear_scale;
+
+        uint32_t bits = as_bits(x);
+        int idx = (int)(bits >> table_shift) - (table_min_exponent << table_mantissa_bits);
+        float frac = (bits & ((1 << table_shift) - 1)) * (1.f / (1 << table_shift));
+
+        return table.values[idx] + (table.values[idx + 1] - table.values[idx]) * frac;
+    }
+
+    uint8_t unorm8(float in)
+    {
+        float x = std::min(std::max(in, 0.f), 1.f);
+
+        if(!(x >= 0))
+            x = 0;
+
+        return (uint8_t)lrintf(x * 255.f);
+    }
+
+    #ifdef PIXEL_X86
+    TARGET_F16C
+    void float_to_half_f16c(const float* in, uint16_t* out, size_t count)
+    {
+        size_t i = 0;
+
+        for(; i + 8 <= count; i += 8)
+        {
+            __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(in + i), _MM_FROUND_TO_NEAREST_INT);
+
+            _mm_storeu_si128((__m128i*)(out + i), h);
+        }
+
+        for(; i < count; i++)
+            out[i] = float_to_half_scalar(in[i]);
+    }
+
+    TARGET_F16C
+    void half_to_float_f16c(const uint16_t* in, float* out, size_t count)
+    {
+        size_t i = 0;
+
+        for(; i + 8 <= count; i += 8)
+        {
+            __m128i h = _mm_loadu_si128((const __m128i*)(in + i));
+
+            _mm256_storeu_ps(out + i, _mm256_cvtph_ps(h));
+        }
+
+        for(; i < count; i++)
+            out[i] = half_to_float_scalar(in[i]);
+    }
+
+    TARGET_AVX2
+    void unorm8_to_float_avx2(const uint8_t* in, float* out, size_t count)
+    {
+        __m256 scale = _mm256_set1_ps(1/255.f);
+
+        size_t i = 0;
+
+        for(; i + 8 <= count; i += 8)
+        {
+            __m256i ints = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(in + i)));
+
+            _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(ints), scale));
+        }
+
+        for(; i < count; i++)
+            out[i] = in[i] / 255.f;
+    }
+
+    ///max(x, 0) returns 0 for nan, as the second operand is returned when either is a nan
+    TARGET_AVX2
+    __m256i float_to_unorm8_lanes_avx2(__m256 x)
+    {
+        x = _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(1.f));
+
+        return _mm256_cvtps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(255.f)));
+    }
+
+    TARGET_AVX2
+    void float_to_unorm8_avx2(const float* in, uint8_t* out, size_t count)
+    {
+        ///packs work within 128 bit lanes, this puts the 32 bit groups back in order
+        __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+        size_t i = 0;
+
+        for(; i + 32 <= count; i += 32)
+        {
+            __m256i a = float_to_unorm8_lanes_avx2(_mm256_loadu_ps(in + i));
+            __m256i b = float_to_unorm8_lanes_avx2(_mm256_loadu_ps(in + i + 8));
+            __m256i c = float_to_unorm8_lanes_avx2(_mm256_loadu_ps(in + i + 16));
+            __m256i d = float_to_unorm8_lanes_avx2(_mm256_loadu_ps(in + i + 24));
+
+            __m256i ab = _mm256_packs_epi32(a, b);
+            __m256i cd = _mm256_packs_epi32(c, d);
+            __m256i abcd = _mm256_packus_epi16(ab, cd);
+
+            _mm256_storeu_si256((__m256i*)(out + i), _mm256_permutevar8x32_epi32(abcd, order));
+        }
+
+        for(; i < count; i++)
+            out[i] = unorm8(in[i]);
+    }
+
+    TARGET_AVX2
+    void apply_table_avx2(const float* in, float* out, size_t count, const curve_table& table)
+    {
+        __m256 zero = _mm256_setzero_ps();
+        __m256 one = _mm256_set1_ps(1.f);
+        __m256 min_value = _mm256_set1_ps(table_min_value);
+        __m256 linear_scale = _mm256_set1_ps(table.linear_scale);
+        __m256 frac_scale = _mm256_set1_ps(1.f / (1 << table_shift));
+        __m256i base = _mm256_set1_epi32(table_min_exponent << table_mantissa_bits);
+        __m256i frac_mask = _mm256_set1_epi32((1 << table_shift) - 1);
+
+        size_t i = 0;
+
+        for(; i + 8 <= count; i += 8)
+        {
+            __m256 x = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(in + i), zero), one);
+            __m256i bits = _mm256_castps_si256(x);
+
+            __m256i idx = _mm256_max_epi32(_mm256_sub_epi32(_mm256_srli_epi32(bits, table_shift), base), _mm256_setzero_si256());
+            __m256 frac = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(bits, frac_mask)), frac_scale);
+
+            __m256 lo = _mm256_i32gather_ps(table.values.data(), idx, 4);
+            __m256 hi = _mm256_i32gather_ps(table.values.data() + 1, idx, 4);
+
+            __m256 curve = _mm256_add_ps(lo, _mm256_mul_ps(_mm256_sub_ps(hi, lo), frac));
+            __m256 linear = _mm256_mul_ps(x, linear_scale);
+
+            __m256 is_small = _mm256_cmp_ps(x, min_value, _CMP_LT_OQ);
+
+            _mm256_storeu_ps(out + i, _mm256_blendv_ps(curve, linear, is_small));
+        }
+
+        for(; i < count; i++)
+            out[i] = apply_table_scalar(in[i], table);
+    }
+
+    TARGET_SSE2
+    void unorm8_to_float_sse2(const uint8_t* in, float* out, size_t count)
+    {
+        __m128 scale = _mm_set1_ps(1/255.f);
+        __m128i zero = _mm_setzero_si128();
+
+        size_t i = 0;
+
+        for(; i + 16 <= count; i += 16)
+        {
+            __m128i bytes = _mm_loadu_si128((const __m128i*)(in + i));
+
+            __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+            __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+
+            _mm_storeu_ps(out + i + 0, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+            _mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+            _mm_storeu_ps(out + i + 8, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+            _mm_storeu_ps(out + i + 12, _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+        }
+
+        for(; i < count; i++)
+            out[i] = in[i] / 255.f;
+    }
+
+    TARGET_SSE2
+    __m128i float_to_unorm8_lanes_sse2(__m128 x)
+    {
+        x = _mm_min_ps(_mm_max_ps(x, _mm_setzero_ps()), _mm_set1_ps(1.f));
+
+        return _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(255.f)));
+    }
+
+    TARGET_SSE2
+    void float_to_unorm8_sse2(const float* in, uint8_t* out, size_t count)
+    {
+        size_t i = 0;
+
+        for(; i + 16 <= count; i += 16)
+        {
+            __m128i a = float_to_unorm8_lanes_sse2(_mm_loadu_ps(in + i));
+            __m128i b = float_to_unorm8_lanes_sse2(_mm_loadu_ps(in + i + 4));
+            __m128i c = float_to_unorm8_lanes_sse2(_mm_loadu_ps(in + i + 8));
+            __m128i d = float_to_unorm8_lanes_sse2(_mm_loadu_ps(in + i + 12));
+
+            __m128i packed = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+
+            _mm_storeu_si128((__m128i*)(out + i), packed);
+        }
+
+        for(; i < count; i++)
+            out[i] = unorm8(in[i]);
+    }
+    #endif // PIXEL_X86
+
+    void apply_table(const float* in, float* out, size_t count, const curve_table& table)
+    {
+        #ifdef PIXEL_X86
+        if(features().avx2)
+            return apply_table_avx2(in, out, count, table);
+        #endif // PIXEL_X86
+
+        for(size_t i=0; i < count; i++)
+            out[i] = apply_table_scalar(in[i], table);
+    }
+}
+
+void pixel::float_to_half(const float* in, uint16_t* out, size_t count)
+{
+    #ifdef PIXEL_X86
+    if(features().f16c)
+        return float_to_half_f16c(in, out, count);
+    #endif // PIXEL_X86
+
+    for(size_t i=0; i < count; i++)
+        out[i] = float_to_half_scalar(in[i]);
+}
+
+void pixel::half_to_float(const uint16_t* in, float* out, size_t count)
+{
+    #ifdef PIXEL_X86
+    if(features().f16c)
+        return half_to_float_f16c(in, out, count);
+    #endif // PIXEL_X86
+
+    for(size_t i=0; i < count; i++)
+        out[i] = half_to_float_scalar(in[i]);
+}
+
+void pixel::rgba8_to_float4(const uint8_t* in, float* out, size_t pixels, bool srgb)
+{
+    if(srgb)
+    {
+        const std::array<float, 256>& table = srgb8_to_linear_table();
+
+        for(size_t i=0; i < pixels; i++)
+        {
+            out[i * 4 + 0] = table[in[i * 4 + 0]];
+            out[i * 4 + 1] = table[in[i * 4 + 1]];
+            out[i * 4 + 2] = table[in[i * 4 + 2]];
+            out[i * 4 + 3] = in[i * 4 + 3] / 255.f;
+        }
+
+        return;
+    }
+
+    #ifdef PIXEL_X86
+    if(features().avx2)
+        return unorm8_to_float_avx2(in, out, pixels * 4);
+
+    if(features().sse2)
+        return unorm8_to_float_sse2(in, out, pixels * 4);
+    #endif // PIXEL_X86
+
+    for(size_t i=0; i < pixels * 4; i++)
+        out[i] = in[i] / 255.f;
+}
+
+void pixel::float4_to_rgba8(const float* in, uint8_t* out, size_t pixels, bool srgb)
+{
+    if(srgb)
+    {
+        const curve_table& table = linear_to_srgb_table();
+
+        for(size_t i=0; i < pixels; i++)
+        {
+            out[i * 4 + 0] = unorm8(apply_table_scalar(in[i * 4 + 0], table));
+            out[i * 4 + 1] = unorm8(apply_table_scalar(in[i * 4 + 1], table));
+            out[i * 4 + 2] = unorm8(apply_table_scalar(in[i * 4 + 2], table));
+            out[i * 4 + 3] = unorm8(in[i * 4 + 3]);
+        }
+
+        return;
+    }
+
+    #ifdef PIXEL_X86
+    if(features().avx2)
+        return float_to_unorm8_avx2(in, out, pixels * 4);
+
+    if(features().sse2)
+        return float_to_unorm8_sse2(in, out, pixels * 4);
+    #endif // PIXEL_X86
+
+    for(size_t i=0; i < pixels * 4; i++)
+        out[i] = unorm8(in[i]);
+}
+
+void pixel::srgb_to_linear(const float* in, float* out, size_t count)
+{
+    apply_table(in, out, count, srgb_to_linear_table());
+}
+
+void pixel::linear_to_srgb(const float* in, float* out, size_t count)
+{
+    apply_table(in, out, count, linear_to_srgb_table());
+}
+
+float pixel::srgb_to_linear(float in)
+{
+    return srgb_to_linear_exact(in);
+}
+
+float pixel::linear_to_srgb(float in)
+{
+    return linear_to_srgb_exact(in);
+}
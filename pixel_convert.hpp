@@ -0,0 +1,28 @@
+#ifndef PIXEL_CONVERT_HPP_INCLUDED
+#define PIXEL_CONVERT_HPP_INCLUDED
+
+#include <cstdint>
+#include <cstddef>
+
+///bulk pixel format conversion for uploads and readbacks. Picks AVX2/F16C or SSE2 at runtime where the cpu has them, otherwise scalar
+namespace pixel
+{
+    ///round to nearest even. Infinities and nans are preserved
+    void float_to_half(const float* in, uint16_t* out, size_t count);
+    void half_to_float(const uint16_t* in, float* out, size_t count);
+
+    ///counts are in pixels. srgb decodes or encodes the colour channels, alpha is always linear
+    void rgba8_to_float4(const uint8_t* in, float* out, size_t pixels, bool srgb = false);
+    ///clamps to [0, 1]
+    void float4_to_rgba8(const float* in, uint8_t* out, size_t pixels, bool srgb = false);
+
+    ///every element is converted, and clamped to [0, 1]. in and out may be the same
+    void srgb_to_linear(const float* in, float* out, size_t count);
+    void linear_to_srgb(const float* in, float* out, size_t count);
+
+    ///exact, for single values
+    float srgb_to_linear(float in);
+    float linear_to_srgb(float in);
+}
+
+#endif // PIXEL_CONVERT_HPP_INCLUDED
@@ -11,6 +11,9 @@
 #include "render_window_glfw.hpp"
 #include "clipboard.hpp"
 #include <functional>
+#include <algorithm>
+#include <array>
+#include <cmath>
 
 #ifdef USE_IMTUI
 #include <imtui/imtui.h>
@@ -28,7 +31,7 @@
 
 namespace
 {
-    thread_local std::map<std::string, bool> frost_map;
+    thread_local std::map<std::string, float> frost_map;
 }
 
 
@@ -197,10 +200,87 @@ std::vector<dropped_file> emscripten_drag_drop::get_dropped_files()
     return files;
 }
 
-///just realised a much faster version of this
-///unconditionally blur whole screen, then only clip bits we want
 #ifndef NO_OPENCL
 #ifndef NO_OPENCL_SCREEN
+namespace
+{
+    constexpr int max_frost_levels = 6;
+
+    ///half open pixel bounds
+    struct frost_rect
+    {
+        int x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+
+        frost_rect half() const
+        {
+            return {x0 / 2, y0 / 2, (x1 + 1) / 2, (y1 + 1) / 2};
+        }
+
+        cl_float4 as_float4() const
+        {
+            cl_float4 ret;
+            ret.s[0] = x0;
+            ret.s[1] = y0;
+            ret.s[2] = x1;
+            ret.s[3] = y1;
+
+            return ret;
+        }
+    };
+
+    void ensure_frost_pyramid(opencl_context& clctx, int64_t screen_w, int64_t screen_h)
+    {
+        int w = std::max((screen_w + 1) / 2, (int64_t)1);
+        int h = std::max((screen_h + 1) / 2, (int64_t)1);
+
+        if(clctx.frost_pyramid.size() == max_frost_levels && clctx.frost_pyramid[0].sizes[0] == w && clctx.frost_pyramid[0].sizes[1] == h)
+            return;
+
+        clctx.frost_pyramid.clear();
+
+        for(int i=0; i < max_frost_levels; i++)
+        {
+            cl::image& img = clctx.frost_pyramid.emplace_back(clctx.ctx);
+            img.memory_tag = "frost";
+            img.alloc({w, h}, {CL_RGBA, CL_HALF_FLOAT});
+
+            w = std::max((w + 1) / 2, 1);
+            h = std::max((h + 1) / 2, 1);
+        }
+    }
+
+    template<typename S, typename D>
+    void frost_pass(cl::command_queue& cqueue, const std::string& kernel, S& src, D& dst, const frost_rect& src_rect, const frost_rect& dst_rect, float offset, cl::buffer* rects = nullptr, int rect_count = 0)
+    {
+        int w = dst_rect.x1 - dst_rect.x0;
+        int h = dst_rect.y1 - dst_rect.y0;
+
+        if(w <= 0 || h <= 0)
+            return;
+
+        cl::args args;
+        args.push_back(src);
+        args.push_back(dst);
+        args.push_back(src_rect.as_float4());
+        args.push_back(w);
+        args.push_back(h);
+        args.push_back(dst_rect.x0);
+        args.push_back(dst_rect.y0);
+        args.push_back(offset);
+
+        if(rects)
+        {
+            args.push_back(*rects);
+            args.push_back(rect_count);
+        }
+
+        cqueue.exec(kernel, args, std::vector<size_t>{(size_t)w, (size_t)h}, std::vector<size_t>{16, 16});
+    }
+}
+
+///dual kawase: downsample the union of every frosted window through a half resolution pyramid, then upsample back up
+///the final upsample only writes pixels covered by a window, so the dispatch count is 2 * levels regardless of how many windows are frosted
+///windows see their surroundings within the union, and share the largest requested radius
 void blur_buffer(render_window& win, cl::gl_rendertexture& tex)
 {
     std::vector<frostable> frosty = win.get_frostables();
@@ -208,46 +288,83 @@ void blur_buffer(render_window& win, cl::gl_rendertexture& tex)
     if(frosty.size() == 0)
         return;
 
-    glFinish();
+    opencl_context& clctx = *win.clctx;
 
-    tex.acquire(win.clctx->cqueue);
+    int screen_w = tex.sizes[0];
+    int screen_h = tex.sizes[1];
 
-    win.clctx->cl_image.clear(win.clctx->cqueue);
+    std::vector<cl_int4> rect_data;
+    frost_rect bounds = {screen_w, screen_h, 0, 0};
+    float radius = 1;
 
-    for(int i=0; i < 80; i++)
     for(frostable& f : frosty)
     {
         int ix = f.pos.x();
         int iy = win.get_window_size().y() - f.pos.y() - f.dim.y();
 
-        int dx = f.dim.x();
-        int dy = f.dim.y();
+        frost_rect r;
+        r.x0 = std::clamp(ix, 0, screen_w);
+        r.y0 = std::clamp(iy, 0, screen_h);
+        r.x1 = std::clamp(ix + f.dim.x(), 0, screen_w);
+        r.y1 = std::clamp(iy + f.dim.y(), 0, screen_h);
 
-        cl::args blur;
+        if(r.x1 <= r.x0 || r.y1 <= r.y0)
+            continue;
 
-        blur.push_back(tex);
-        blur.push_back(win.clctx->cl_image);
-        blur.push_back(dx);
-        blur.push_back(dy);
-        blur.push_back(ix);
-        blur.push_back(iy);
+        cl_int4 as_int;
+        as_int.s[0] = r.x0;
+        as_int.s[1] = r.y0;
+        as_int.s[2] = r.x1;
+        as_int.s[3] = r.y1;
 
-        win.clctx->cqueue.exec("blur_image", blur, {dx, dy}, {16, 16});
+        rect_data.push_back(as_int);
 
-        cl::args blur2;
+        bounds.x0 = std::min(bounds.x0, r.x0);
+        bounds.y0 = std::min(bounds.y0, r.y0);
+        bounds.x1 = std::max(bounds.x1, r.x1);
+        bounds.y1 = std::max(bounds.y1, r.y1);
 
-        blur2.push_back(win.clctx->cl_image);
-        blur2.push_back(tex);
-        blur2.push_back(dx);
-        blur2.push_back(dy);
-        blur2.push_back(ix);
-        blur2.push_back(iy);
-
-        win.clctx->cqueue.exec("blur_image", blur2, {dx, dy}, {16, 16});
+        radius = std::max(radius, f.radius);
     }
 
-    tex.unacquire(win.clctx->cqueue);
-    win.clctx->cqueue.block();
+    if(rect_data.size() == 0)
+        return;
+
+    glFinish();
+
+    ensure_frost_pyramid(clctx, screen_w, screen_h);
+
+    int64_t rect_bytes = rect_data.size() * sizeof(cl_int4);
+
+    if(clctx.frost_rects.alloc_size < rect_bytes)
+        clctx.frost_rects.alloc(rect_bytes);
+
+    clctx.frost_rects.write(clctx.cqueue, rect_data);
+
+    ///a level with a tap offset of 1 roughly doubles the radius, the offset covers the fraction in between
+    int levels = std::clamp((int)std::floor(std::log2(radius)), 1, max_frost_levels);
+    float offset = radius / (float)(1 << levels);
+
+    std::array<frost_rect, max_frost_levels + 1> rects;
+    rects[0] = bounds;
+
+    for(int i=1; i <= levels; i++)
+        rects[i] = rects[i - 1].half();
+
+    tex.acquire(clctx.cqueue);
+
+    frost_pass(clctx.cqueue, "frost_downsample", tex, clctx.frost_pyramid[0], rects[0], rects[1], offset);
+
+    for(int i=1; i < levels; i++)
+        frost_pass(clctx.cqueue, "frost_downsample", clctx.frost_pyramid[i - 1], clctx.frost_pyramid[i], rects[i], rects[i + 1], offset);
+
+    for(int i=levels - 1; i >= 1; i--)
+        frost_pass(clctx.cqueue, "frost_upsample", clctx.frost_pyramid[i], clctx.frost_pyramid[i - 1], rects[i + 1], rects[i], offset);
+
+    frost_pass(clctx.cqueue, "frost_composite", clctx.frost_pyramid[0], tex, rects[1], rects[0], offset, &clctx.frost_rects, (int)rect_data.size());
+
+    tex.unacquire(clctx.cqueue);
+    clctx.cqueue.block();
 }
 #endif
 #endif // NO_OPENCL
@@ -256,7 +373,9 @@ void post_render(const ImDrawList* parent_list, const ImDrawCmd* cmd)
 {
     render_window* win = (render_window*)cmd->UserCallbackData;
 
-    assert(win->clctx);
+    ///a deferred context may not exist yet
+    if(win->clctx == nullptr)
+        return;
 
     #ifndef NO_OPENCL
     #ifndef NO_OPENCL_SCREEN
@@ -344,9 +463,44 @@ void imtui_backend::close()
 #endif // USE_IMTUI
 
 #ifndef NO_OPENCL
+cl_image_format get_screen_cl_format(screen_precision::type precision)
+{
+    if(precision == screen_precision::HALF_FLOAT)
+        return {CL_RGBA, CL_HALF_FLOAT};
+
+    if(precision == screen_precision::RGB10_A2)
+        return {CL_RGBA, CL_UNORM_INT16};
+
+    if(precision == screen_precision::RGBA8)
+        return {CL_RGBA, CL_UNORM_INT8};
+
+    return {CL_RGBA, CL_FLOAT};
+}
+
+cl::gl_transfer_format::type get_screen_transfer_format(screen_precision::type precision)
+{
+    ///10 bit channels fit losslessly in a half's mantissa
+    if(precision == screen_precision::HALF_FLOAT || precision == screen_precision::RGB10_A2)
+        return cl::gl_transfer_format::HALF_FLOAT;
+
+    if(precision == screen_precision::RGBA8)
+        return cl::gl_transfer_format::UNORM8;
+
+    return cl::gl_transfer_format::FLOAT;
+}
+
 opencl_context::opencl_context() : ctx(),
 #ifndef NO_OPENCL_SCREEN
-    cl_screen_tex(ctx), cl_image(ctx),
+    cl_screen_tex(ctx), cl_image(ctx), frost_rects(ctx),
+#endif
+    cqueue(ctx)
+{
+
+}
+
+opencl_context::opencl_context(cl::context& in) : ctx(in),
+#ifndef NO_OPENCL_SCREEN
+    cl_screen_tex(ctx), cl_image(ctx), frost_rects(ctx),
 #endif
     cqueue(ctx)
 {
@@ -371,7 +525,7 @@ render_window::render_window(render_settings sett, generic_backend* _backend)
 
     settings = sett;
 
-    if(sett.opencl && backend->get_opencl_context())
+    if(sett.opencl && !backend->is_opencl_pending() && backend->get_opencl_context())
     {
         clctx = backend->get_opencl_context();
     }
@@ -411,7 +565,7 @@ render_window::render_window(render_settings sett, const std::string& window_tit
 
     settings = sett;
 
-    if(sett.opencl && backend->get_opencl_context())
+    if(sett.opencl && !backend->is_opencl_pending() && backend->get_opencl_context())
     {
         clctx = backend->get_opencl_context();
     }
@@ -439,6 +593,22 @@ render_window::~render_window()
     }
 }
 
+void render_window::resolve_deferred_opencl()
+{
+    if(clctx != nullptr || !settings.opencl || backend->is_opencl_pending())
+        return;
+
+    clctx = backend->get_opencl_context();
+}
+
+opencl_context* render_window::get_opencl_context()
+{
+    if(clctx == nullptr && settings.opencl)
+        clctx = backend->get_opencl_context();
+
+    return clctx;
+}
+
 render_settings render_window::get_render_settings()
 {
     render_settings sett = settings;
@@ -480,7 +650,7 @@ std::vector<frostable> render_window::get_frostables()
 
             auto it = frost_map.find(name);
 
-            if(it == frost_map.end() || it->second == false)
+            if(it == frost_map.end() || it->second <= 0)
                 continue;
 
             auto pos = window->Pos;
@@ -495,6 +665,7 @@ std::vector<frostable> render_window::get_frostables()
             frostable f;
             f.pos = {pos.x, pos.y};
             f.dim = {dim.x, dim.y};
+            f.radius = it->second;
 
             frosts.push_back(f);
         }
@@ -576,12 +747,12 @@ void render_window::render_texture(unsigned int handle, vec2f p_min, vec2f p_max
     lst->AddImage((void*)handle, {p_min.x(), p_min.y()}, {p_max.x(), p_max.y()});
 }
 
-void gui::frost(const std::string& window_name)
+void gui::frost(const std::string& window_name, float radius)
 {
-    frost_map[window_name] = true;
+    frost_map[window_name] = radius;
 }
 
-void gui::current::frost()
+void gui::current::frost(float radius)
 {
-    return gui::frost(std::string(ImGui::GetCurrentWindow()->Name));
+    return gui::frost(std::string(ImGui::GetCurrentWindow()->Name), radius);
 }
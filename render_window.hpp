@@ -22,6 +22,18 @@ struct dropped_file
     std::string data;
 };
 
+///storage for the main screen texture and its CL images. Lower precision halves or quarters the bandwidth of blits, frosting and readbacks
+namespace screen_precision
+{
+    enum type
+    {
+        FLOAT32,
+        HALF_FLOAT,
+        RGB10_A2,
+        RGBA8,
+    };
+}
+
 struct render_settings : serialisable, free_function
 {
     int width = 0;
@@ -31,9 +43,15 @@ struct render_settings : serialisable, free_function
     bool no_double_buffer = false;
     bool viewports = false;
     bool opencl = false;
+    ///creates the opencl context in the background so the first frame isn't held up by driver startup
+    ///render_window::clctx stays null until it's ready, see render_window::get_opencl_context
+    bool deferred_opencl = false;
     bool vsync = false;
     bool no_decoration = false;
     bool is_taskbar_hidden = false;
+    screen_precision::type screen_format = screen_precision::FLOAT32;
+    ///how many frames the CL screen's upload can lag behind when CL/GL sharing is unavailable. 0 uploads synchronously
+    int opencl_transfer_buffers = 2;
 };
 
 namespace backend_type
@@ -49,6 +67,8 @@ struct frostable
 {
     vec2f pos;
     vec2i dim;
+    ///approximately the standard deviation of the blur, in pixels
+    float radius = 8;
 };
 
 
@@ -64,11 +84,21 @@ struct opencl_context
     #ifndef NO_OPENCL_SCREEN
     cl::gl_rendertexture cl_screen_tex;
     cl::image cl_image;
+    ///half resolution and below, sized lazily to the screen by the frost blur
+    std::vector<cl::image> frost_pyramid;
+    ///cl_int4 rects of every frosted window, uploaded once per frame
+    cl::buffer frost_rects;
     #endif
     cl::command_queue cqueue;
 
     opencl_context();
+    ///blocks until in has been created
+    explicit opencl_context(cl::context& in);
 };
+
+///the CL side of each screen_precision, shared by the backends' init_screen. RGB10_A2 has no widely supported CL equivalent, so is widened to 16 bits
+cl_image_format get_screen_cl_format(screen_precision::type precision);
+cl::gl_transfer_format::type get_screen_transfer_format(screen_precision::type precision);
 #endif // NO_OPENCL
 
 namespace emscripten_drag_drop
@@ -93,7 +123,9 @@ struct generic_backend
     virtual void close(){}
     virtual void init_screen(vec2i dim){(void)dim;}
     virtual void set_is_hidden(bool is_hidden){(void)is_hidden;}
+    ///may block on a deferred context, check is_opencl_pending first to avoid that
     virtual opencl_context* get_opencl_context(){return nullptr;}
+    virtual bool is_opencl_pending(){return false;}
     virtual vec2i get_window_size(){return {ImGui::GetIO().DisplaySize.x, ImGui::GetIO().DisplaySize.y};}
     virtual vec2i get_window_position(){return {0,0};}
     virtual void set_window_position(vec2i pos){(void)pos;}
@@ -158,8 +190,13 @@ struct render_window
     void set_srgb(bool enabled);
     void set_vsync(bool enabled){return backend->set_vsync(enabled);}
 
-    void poll(double maximum_sleep_s = 0){return backend->poll(maximum_sleep_s);}
-    void poll_events_only(double maximum_sleep_s = 0) {return backend->poll_events_only(maximum_sleep_s);}
+    void poll(double maximum_sleep_s = 0){resolve_deferred_opencl(); return backend->poll(maximum_sleep_s);}
+    void poll_events_only(double maximum_sleep_s = 0) {resolve_deferred_opencl(); return backend->poll_events_only(maximum_sleep_s);}
+
+    ///with render_settings::deferred_opencl, fills in clctx once the context has finished being created. Never blocks
+    void resolve_deferred_opencl();
+    ///blocks until clctx is available, if opencl is enabled
+    opencl_context* get_opencl_context();
     void poll_issue_new_frame_only() {return backend->poll_issue_new_frame_only();}
 
     std::vector<frostable> get_frostables();
@@ -183,11 +220,12 @@ private:
 
 namespace gui
 {
-    void frost(const std::string& window_name);
+    ///radius is roughly the standard deviation of the blur in pixels
+    void frost(const std::string& window_name, float radius = 8);
 
     namespace current
     {
-        void frost();
+        void frost(float radius = 8);
     }
 }
 
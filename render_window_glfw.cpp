@@ -71,7 +71,7 @@ void drop_callback(GLFWwindow* window, int count, const char** paths)
 }
 #endif // __EMSCRIPTEN__
 
-void make_fbo(unsigned int* fboptr, unsigned int* tex, vec2i dim, bool is_srgb)
+void make_fbo(unsigned int* fboptr, unsigned int* tex, vec2i dim, bool is_srgb, screen_precision::type precision = screen_precision::FLOAT32)
 {
     int wx = dim.x();
     int wy = dim.y();
@@ -83,7 +83,13 @@ void make_fbo(unsigned int* fboptr, unsigned int* tex, vec2i dim, bool is_srgb)
     glBindTexture(GL_TEXTURE_2D, *tex);
 
     #ifndef __EMSCRIPTEN__
-    if(!is_srgb)
+    if(!is_srgb && precision == screen_precision::HALF_FLOAT)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, wx, wy, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+    else if(!is_srgb && precision == screen_precision::RGB10_A2)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB10_A2, wx, wy, 0, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, NULL);
+    else if(!is_srgb && precision == screen_precision::RGBA8)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, wx, wy, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    else if(!is_srgb)
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, wx, wy, 0, GL_RGBA, GL_FLOAT, NULL);
     else
         glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8, wx, wy, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
@@ -212,8 +218,13 @@ glfw_backend::glfw_backend(const render_settings& sett, const std::string& windo
 
     set_vsync(sett.vsync);
 
+    screen_format = sett.screen_format;
+    screen_transfer_buffers = sett.opencl_transfer_buffers;
+
     #ifndef NO_OPENCL
-    if(sett.opencl)
+    if(sett.opencl && sett.deferred_opencl)
+        deferred_cl.emplace(true);
+    else if(sett.opencl)
         clctx = new opencl_context();
     #endif // NO_OPENCL
 
@@ -244,16 +255,24 @@ void glfw_backend::init_screen(vec2i dim)
         ctx.fbo_srgb = 0;
     }
 
-    make_fbo(&ctx.fbo, &ctx.screen_tex, dim, false);
+    make_fbo(&ctx.fbo, &ctx.screen_tex, dim, false, screen_format);
     make_fbo(&ctx.fbo_srgb, &ctx.screen_tex_srgb, dim, true);
     ctx.screens_init = true;
 
+    screen_dim = dim;
+
+    init_opencl_screen();
+}
+
+void glfw_backend::init_opencl_screen()
+{
     #ifndef NO_OPENCL
     #ifndef NO_OPENCL_SCREEN
     if(clctx)
     {
+        clctx->cl_screen_tex.set_fallback_transfer(get_screen_transfer_format(screen_format), screen_transfer_buffers, true);
         clctx->cl_screen_tex.create_from_texture(ctx.screen_tex);
-        clctx->cl_image.alloc(dim, cl_image_format{CL_RGBA, CL_FLOAT});
+        clctx->cl_image.alloc(screen_dim, get_screen_cl_format(screen_format));
     }
     #endif
     #endif // NO_OPENCL
@@ -805,5 +824,26 @@ void glfw_backend::pop_dropped_file()
 
 opencl_context* glfw_backend::get_opencl_context()
 {
+    #ifndef NO_OPENCL
+    if(clctx == nullptr && deferred_cl.has_value())
+    {
+        clctx = new opencl_context(deferred_cl.value());
+        deferred_cl = std::nullopt;
+
+        ///the gl screen already exists, the CL side was skipped while the context was pending
+        if(screen_dim.x() > 0)
+            init_opencl_screen();
+    }
+    #endif // NO_OPENCL
+
     return clctx;
 }
+
+bool glfw_backend::is_opencl_pending()
+{
+    #ifndef NO_OPENCL
+    return clctx == nullptr && deferred_cl.has_value() && !deferred_cl->is_ready();
+    #else
+    return false;
+    #endif // NO_OPENCL
+}
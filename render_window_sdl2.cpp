@@ -30,7 +30,7 @@
 
 namespace
 {
-void make_fbo(unsigned int* fboptr, unsigned int* tex, vec2i dim, bool is_srgb)
+void make_fbo(unsigned int* fboptr, unsigned int* tex, vec2i dim, bool is_srgb, screen_precision::type precision = screen_precision::FLOAT32)
 {
     int wx = dim.x();
     int wy = dim.y();
@@ -42,7 +42,13 @@ void make_fbo(unsigned int* fboptr, unsigned int* tex, vec2i dim, bool is_srgb)
     glBindTexture(GL_TEXTURE_2D, *tex);
 
     #ifndef __EMSCRIPTEN__
-    if(!is_srgb)
+    if(!is_srgb && precision == screen_precision::HALF_FLOAT)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, wx, wy, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+    else if(!is_srgb && precision == screen_precision::RGB10_A2)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB10_A2, wx, wy, 0, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, NULL);
+    else if(!is_srgb && precision == screen_precision::RGBA8)
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, wx, wy, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    else if(!is_srgb)
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, wx, wy, 0, GL_RGBA, GL_FLOAT, NULL);
     else
         glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8, wx, wy, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
@@ -187,8 +193,13 @@ sdl2_backend::sdl2_backend(const render_settings& sett, const std::string& windo
 {
     set_vsync(sett.vsync);
 
+    screen_format = sett.screen_format;
+    screen_transfer_buffers = sett.opencl_transfer_buffers;
+
     #ifndef NO_OPENCL
-    if(sett.opencl)
+    if(sett.opencl && sett.deferred_opencl)
+        deferred_cl.emplace(true);
+    else if(sett.opencl)
         clctx = new opencl_context;
     #endif // NO_OPENCL
 
@@ -214,15 +225,23 @@ void sdl2_backend::init_screen(vec2i dim)
     if(dim.y() < 32)
         dim.y() = 32;
 
-    make_fbo(&ctx.fbo, &ctx.screen_tex, dim, false);
+    make_fbo(&ctx.fbo, &ctx.screen_tex, dim, false, screen_format);
     make_fbo(&ctx.fbo_srgb, &ctx.screen_tex_srgb, dim, true);
 
+    screen_dim = dim;
+
+    init_opencl_screen();
+}
+
+void sdl2_backend::init_opencl_screen()
+{
     #ifndef NO_OPENCL
     #ifndef NO_OPENCL_SCREEN
     if(clctx)
     {
+        clctx->cl_screen_tex.set_fallback_transfer(get_screen_transfer_format(screen_format), screen_transfer_buffers, true);
         clctx->cl_screen_tex.create_from_texture(ctx.screen_tex);
-        clctx->cl_image.alloc(dim, cl_image_format{CL_RGBA, CL_FLOAT});
+        clctx->cl_image.alloc(screen_dim, get_screen_cl_format(screen_format));
     }
     #endif
     #endif // NO_OPENCL
@@ -628,5 +647,26 @@ void sdl2_backend::pop_dropped_file()
 
 opencl_context* sdl2_backend::get_opencl_context()
 {
+    #ifndef NO_OPENCL
+    if(clctx == nullptr && deferred_cl.has_value())
+    {
+        clctx = new opencl_context(deferred_cl.value());
+        deferred_cl = std::nullopt;
+
+        ///the gl screen already exists, the CL side was skipped while the context was pending
+        if(screen_dim.x() > 0)
+            init_opencl_screen();
+    }
+    #endif // NO_OPENCL
+
     return clctx;
 }
+
+bool sdl2_backend::is_opencl_pending()
+{
+    #ifndef NO_OPENCL
+    return clctx == nullptr && deferred_cl.has_value() && !deferred_cl->is_ready();
+    #else
+    return false;
+    #endif // NO_OPENCL
+}
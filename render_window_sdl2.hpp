@@ -26,6 +26,14 @@ struct sdl2_backend : generic_backend
 {
     sdl2_render_context ctx;
     opencl_context* clctx = nullptr;
+    screen_precision::type screen_format = screen_precision::FLOAT32;
+    int screen_transfer_buffers = 2;
+    #ifndef NO_OPENCL
+    ///render_settings::deferred_opencl, until it's turned into clctx
+    std::optional<cl::context> deferred_cl;
+    #endif // NO_OPENCL
+    ///the last init_screen, for sizing the CL screen once a deferred context arrives
+    vec2i screen_dim = {0, 0};
 
     sdl2_backend(const render_settings& sett, const std::string& window_title);
     ~sdl2_backend();
@@ -41,6 +49,9 @@ struct sdl2_backend : generic_backend
     void close() override;
     void init_screen(vec2i dim) override;
     opencl_context* get_opencl_context() override;
+    bool is_opencl_pending() override;
+    ///(re)creates the CL screen against the current gl screen, a no-op without clctx
+    void init_opencl_screen();
     vec2i get_window_size() override;
     vec2i get_window_position() override;
     void set_window_position(vec2i position) override;
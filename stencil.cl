@@ -0,0 +1,108 @@
+#ifndef STENCIL_CL_INCLUDED
+#define STENCIL_CL_INCLUDED
+
+///tiled stencils. Each work group loads its output tile plus a halo into local memory once, then every work item
+///evaluates a stencil function over the tile instead of fetching each tap from the image
+///the work group size must be STENCIL_TILE_W x STENCIL_TILE_H, ie pass {16, 16} as the local size. #include into any program which needs them
+#ifndef STENCIL_TILE_W
+#define STENCIL_TILE_W 16
+#endif
+
+#ifndef STENCIL_TILE_H
+#define STENCIL_TILE_H 16
+#endif
+
+struct stencil_tile
+{
+    __local const float4* data;
+    int stride;
+    ///the centre tap, in tile coordinates and in source pixels
+    int2 local_pos;
+    int2 pos;
+    ///taps are clamped into [region_min, region_max)
+    int2 region_min;
+    int2 region_max;
+};
+
+float4 stencil_tap(struct stencil_tile st, int dx, int dy)
+{
+    return st.data[(st.local_pos.y + dy) * st.stride + st.local_pos.x + dx];
+}
+
+///whether a tap was really inside the region, rather than clamped to its edge
+bool stencil_inside(struct stencil_tile st, int dx, int dy)
+{
+    int2 test = st.pos + (int2)(dx, dy);
+
+    return all(test >= st.region_min) && all(test < st.region_max);
+}
+
+///every work item in the group must call this, as it contains a barrier
+///scale is the number of source pixels per output pixel along each axis, the source region is the output region * scale
+struct stencil_tile stencil_load(__read_only image2d_t read_buf, __local float4* tile, int scale, int rx, int ry, int w, int h, int ox, int oy)
+{
+    sampler_t sam = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+
+    int lx = get_local_id(0);
+    int ly = get_local_id(1);
+
+    int2 region_min = max((int2)(ox, oy) * scale, 0);
+    int2 region_max = min((int2)(ox + w, oy + h) * scale, (int2)(get_image_width(read_buf), get_image_height(read_buf)));
+    region_max = max(region_max, region_min + 1);
+
+    int tile_w = STENCIL_TILE_W * scale + 2 * rx;
+    int tile_h = STENCIL_TILE_H * scale + 2 * ry;
+
+    int2 tile_origin = ((int2)((int)get_group_id(0) * STENCIL_TILE_W, (int)get_group_id(1) * STENCIL_TILE_H) + (int2)(ox, oy)) * scale - (int2)(rx, ry);
+
+    for(int i = ly * STENCIL_TILE_W + lx; i < tile_w * tile_h; i += STENCIL_TILE_W * STENCIL_TILE_H)
+    {
+        int2 pos = tile_origin + (int2)(i % tile_w, i / tile_w);
+
+        tile[i] = read_imagef(read_buf, sam, clamp(pos, region_min, region_max - 1));
+    }
+
+    barrier(CLK_LOCAL_MEM_FENCE);
+
+    struct stencil_tile st;
+    st.data = tile;
+    st.stride = tile_w;
+    st.local_pos = (int2)(lx * scale + rx, ly * scale + ry);
+    st.pos = tile_origin + st.local_pos;
+    st.region_min = region_min;
+    st.region_max = region_max;
+
+    return st;
+}
+
+///the body of a stencil kernel with read_buf, write_buf, w, h, ox, oy in scope. Writes FUNC(struct stencil_tile, PARAM) to every pixel in the output region
+///RX and RY are the stencil's reach in source pixels, a separable pass has a zero radius along one axis
+#define STENCIL_BODY(SCALE, RX, RY, FUNC, PARAM) \
+{ \
+    __local float4 tile[(STENCIL_TILE_W * (SCALE) + 2 * (RX)) * (STENCIL_TILE_H * (SCALE) + 2 * (RY))]; \
+\
+    struct stencil_tile st = stencil_load(read_buf, tile, SCALE, RX, RY, w, h, ox, oy); \
+\
+    int x = get_global_id(0); \
+    int y = get_global_id(1); \
+\
+    if(x >= w || y >= h) \
+        return; \
+\
+    x += ox; \
+    y += oy; \
+\
+    if(x < 0 || y < 0 || x >= get_image_width(write_buf) || y >= get_image_height(write_buf)) \
+        return; \
+\
+    write_imagef(write_buf, (int2){x, y}, FUNC(st, PARAM)); \
+}
+
+///declares a stencil kernel taking (read_buf, write_buf, w, h, ox, oy, param)
+#define STENCIL_KERNEL(name, SCALE, RX, RY, FUNC) \
+__kernel \
+__attribute__((reqd_work_group_size(STENCIL_TILE_W, STENCIL_TILE_H, 1))) \
+void name(__read_only image2d_t read_buf, __write_only image2d_t write_buf, int w, int h, int ox, int oy, float param) \
+STENCIL_BODY(SCALE, RX, RY, FUNC, param)
+
+#endif // STENCIL_CL_INCLUDED